@@ -0,0 +1,438 @@
+/*
+ * Shiraz allocation budgets
+ * ================
+ * Every allocation Shiraz makes goes through the SRZ_MALLOC() family, which are
+ * pointed at counters here. Each case runs a schema and a command line through
+ * the stream phases, and through srz_parse_cfg() in one go, recording the number
+ * of allocations, the peak bytes held and the stack touched. A figure over its
+ * committed budget is a regression, and the harness exits non-zero.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+static void* alloc_malloc(size_t size);
+static void* alloc_calloc(size_t count, size_t size);
+static void* alloc_realloc(void* ptr, size_t size);
+static void alloc_free(void* ptr);
+
+#define SRZ_MALLOC(size)        alloc_malloc(size)
+#define SRZ_CALLOC(count, size) alloc_calloc(count, size)
+#define SRZ_REALLOC(ptr, size)  alloc_realloc(ptr, size)
+#define SRZ_FREE(ptr)           alloc_free(ptr)
+#define SRZ_PARALLEL 0 //Thread stacks would not be seen
+
+#include "shiraz.h"
+
+
+/*
+ * Counting allocator. Each block carries its size in front, so frees and
+ * reallocations can keep the live byte count exact.
+ */
+
+typedef union alloc_hdr {
+    size_t size;
+    max_align_t align;
+} alloc_hdr_t;
+
+static size_t alloc_count;  //Allocations, including reallocations, since the phase began
+static size_t alloc_live;   //Bytes held right now
+static size_t alloc_peak;   //Most bytes held at once since the phase began
+
+static void alloc_grew(size_t size)
+{
+    alloc_count++;
+    alloc_live += size;
+    if(alloc_live > alloc_peak){
+        alloc_peak = alloc_live;
+    }
+}
+
+static void* alloc_malloc(size_t size)
+{
+    alloc_hdr_t* hdr = malloc(sizeof(alloc_hdr_t) + size);
+    if(!hdr){
+        return NULL;
+    }
+    hdr->size = size;
+    alloc_grew(size);
+    return hdr + 1;
+}
+
+static void* alloc_calloc(size_t count, size_t size)
+{
+    if(size && count > SIZE_MAX / size){
+        return NULL;
+    }
+    void* ptr = alloc_malloc(count * size);
+    if(ptr){
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+static void* alloc_realloc(void* ptr, size_t size)
+{
+    if(!ptr){
+        return alloc_malloc(size);
+    }
+
+    alloc_hdr_t* hdr = (alloc_hdr_t*)ptr - 1;
+    const size_t old = hdr->size;
+    hdr = realloc(hdr, sizeof(alloc_hdr_t) + size);
+    if(!hdr){
+        return NULL;
+    }
+    hdr->size = size;
+    alloc_live -= old;
+    alloc_grew(size);
+    return hdr + 1;
+}
+
+static void alloc_free(void* ptr)
+{
+    if(ptr){
+        alloc_hdr_t* hdr = (alloc_hdr_t*)ptr - 1;
+        alloc_live -= hdr->size;
+        free(hdr);
+    }
+}
+
+
+/*
+ * Stack high-water. A region below the caller's stack pointer is painted, the
+ * phase runs over it, and the bytes no longer holding the paint are the stack
+ * it touched. The region belongs to no frame, so nothing points into a dead one.
+ */
+
+#define STACK_AREA (256 * 1024)
+#define STACK_GAP  128 //Left alone below the painting frame, its red zone
+#define STACK_PAINT 0xA5
+
+static volatile unsigned char* stack_area; //Deepest painted byte, the stack grows down towards it
+
+__attribute__((noinline)) static void stack_paint(void)
+{
+    const uintptr_t sp = (uintptr_t)__builtin_frame_address(0);
+    stack_area = (volatile unsigned char*)(sp - STACK_GAP - STACK_AREA);
+    //From the top down, so the kernel grows the stack a page at a time
+    for(size_t i = STACK_AREA; i-- > 0;){
+        stack_area[i] = STACK_PAINT;
+    }
+}
+
+//Read back from the deepest byte up
+__attribute__((noinline)) static size_t stack_used(void)
+{
+    size_t i = 0;
+    while(i < STACK_AREA && stack_area[i] == STACK_PAINT){
+        i++;
+    }
+    return STACK_AREA - i;
+}
+
+
+/*
+ * Schemas and command lines
+ */
+
+#define CASE_OPTS 1024
+#define CASE_TOKS 64
+
+typedef struct alloc_case_data {
+    srz_opt_t opts[CASE_OPTS + 1];
+    srz_cfg_t cfg;
+    char* toks[CASE_TOKS];
+    char tok_buf[CASE_TOKS][48];
+    size_t ntoks;
+    char* vector;   //A long delimited value, when the command line has one
+} alloc_case_data_t;
+
+//Destinations, shared by every schema
+static bool dst_flag;
+static int dst_int;
+static char* dst_str;
+static char* dst_pos;
+static double* dst_vec;
+static int dst_enm;
+static uint64_t dst_size;
+static int dst_many[CASE_OPTS];
+
+static char opt_names[CASE_OPTS][24];
+static srz_enum_t enm_small[] = { { 0, "fast" }, { 1, "small" }, { 2, "safe" }, { 3, "debug" }, SRZ_ENUM_FIN };
+static srz_enum_t enm_large[CASE_OPTS + 1];
+
+static void tok_add(alloc_case_data_t* d, const char* tok)
+{
+    snprintf(d->tok_buf[d->ntoks], sizeof(d->tok_buf[d->ntoks]), "%s", tok);
+    d->toks[d->ntoks] = d->tok_buf[d->ntoks];
+    d->ntoks++;
+}
+
+static void opt_set(srz_opt_t* opt, int ident, srz_atype_t atype, char* srt, char* lng, srz_val_type_t type, void* dest)
+{
+    srz_opt_t o = SRZ_REQ(ident, srt, lng, "an option");
+    o.atype    = atype;
+    o.val.type = type;
+    o.val.dest = dest;
+    *opt = o;
+}
+
+static void schema_small(alloc_case_data_t* d)
+{
+    opt_set(&d->opts[0], 0, SRZ_ARG_NON, "f", "flag",   SRZ_VAL_BOOL,   &dst_flag);
+    opt_set(&d->opts[1], 1, SRZ_ARG_REQ, "i", "int",    SRZ_VAL_INT,    &dst_int);
+    opt_set(&d->opts[2], 2, SRZ_ARG_REQ, "s", "string", SRZ_VAL_STR,    &dst_str);
+    opt_set(&d->opts[3], 3, SRZ_ARG_REQ, "v", "values", SRZ_VAL_DOUBLE, &dst_vec);
+    opt_set(&d->opts[4], 4, SRZ_ARG_REQ, "m", "mode",   SRZ_VAL_ENUM,   &dst_enm);
+    opt_set(&d->opts[5], 5, SRZ_ARG_REQ, "z", "size",   SRZ_VAL_SIZE,   &dst_size);
+    opt_set(&d->opts[6], 6, SRZ_ARG_POS, "",  "input",  SRZ_VAL_STR,    &dst_pos);
+    d->opts[3].val.is_vector = true;
+    d->opts[3].val.delim     = ',';
+    d->opts[4].val.enm_map   = enm_small;
+    srz_opt_t fin = SRZ_FIN;
+    d->opts[7] = fin;
+}
+
+//All kept by argv_values()
+static const srz_rule_t case_rules[] = { SRZ_REQUIRED(0, 1), SRZ_REQUIRES(3, 1, 2), SRZ_ONE_OF(4), SRZ_RULE_FIN };
+
+static void schema_rules(alloc_case_data_t* d)
+{
+    schema_small(d);
+    d->cfg.rules = case_rules;
+}
+
+static void schema_large(alloc_case_data_t* d)
+{
+    for(size_t i = 0; i < CASE_OPTS; i++){
+        snprintf(opt_names[i], sizeof(opt_names[i]), "option-%zu", i);
+        opt_set(&d->opts[i], (int)i, SRZ_ARG_REQ, "", opt_names[i], SRZ_VAL_INT, &dst_many[i]);
+    }
+    srz_opt_t fin = SRZ_FIN;
+    d->opts[CASE_OPTS] = fin;
+}
+
+static void schema_enum(alloc_case_data_t* d)
+{
+    for(size_t i = 0; i < CASE_OPTS; i++){
+        snprintf(opt_names[i], sizeof(opt_names[i]), "value-%zu", i);
+        srz_enum_t e = { .val = (int)i, .str = opt_names[i] };
+        enm_large[i] = e;
+    }
+    srz_enum_t efin = SRZ_ENUM_FIN;
+    enm_large[CASE_OPTS] = efin;
+
+    opt_set(&d->opts[0], 0, SRZ_ARG_NON, "f", "flag", SRZ_VAL_BOOL, &dst_flag);
+    opt_set(&d->opts[1], 1, SRZ_ARG_REQ, "e", "enum", SRZ_VAL_ENUM, &dst_enm);
+    d->opts[1].val.enm_map = enm_large;
+    srz_opt_t fin = SRZ_FIN;
+    d->opts[2] = fin;
+}
+
+static void argv_empty(alloc_case_data_t* d)
+{
+    (void)d;
+}
+
+static void argv_values(alloc_case_data_t* d)
+{
+    const char* toks[] = { "-f", "--int=42", "-s", "name", "--values=1.5,2.5", "--mode", "safe", "-z64MiB", "input" };
+    for(size_t i = 0; i < sizeof(toks) / sizeof(toks[0]); i++){
+        tok_add(d, toks[i]);
+    }
+}
+
+static void argv_vector(alloc_case_data_t* d)
+{
+    enum { VALUES = 4096 };
+    d->vector = malloc(VALUES * 8 + 16);
+    size_t len = (size_t)sprintf(d->vector, "--values=");
+    for(size_t i = 0; i < VALUES; i++){
+        len += (size_t)sprintf(d->vector + len, "%zu.5,", i);
+    }
+    d->vector[len - 1] = '\0';
+    d->toks[d->ntoks++] = d->vector;
+}
+
+static void argv_typos(alloc_case_data_t* d)
+{
+    const char* toks[] = { "--flga", "--strng=x", "--vlaues=1", "--mdoe=fast", "--sise=1k", "-q" };
+    for(size_t i = 0; i < sizeof(toks) / sizeof(toks[0]); i++){
+        tok_add(d, toks[i]);
+    }
+}
+
+static void argv_large(alloc_case_data_t* d)
+{
+    for(size_t i = 0; i < 16; i++){
+        char tok[48];
+        snprintf(tok, sizeof(tok), "--option-%zu=%zu", i * 61, i);
+        tok_add(d, tok);
+    }
+    tok_add(d, "--optoin-17=1");
+}
+
+static void argv_enum(alloc_case_data_t* d)
+{
+    tok_add(d, "-f");
+    tok_add(d, "--enum=value-999");
+    tok_add(d, "--enum=vaule-12");
+}
+
+
+/*
+ * Cases and budgets
+ */
+
+typedef enum {
+    PHASE_OPEN,     //srz_stream_open(), compiling the schema
+    PHASE_FEED,     //srz_feed() of every token, storing the values
+    PHASE_FINISH,   //srz_finish(), checking the rules and releasing the stream
+    PHASE_PARSE,    //srz_parse_cfg() of the same command line, start to finish
+    PHASES,
+} alloc_phase_t;
+
+static const char* phase_names[PHASES] = { "open", "feed", "finish", "parse" };
+
+typedef struct alloc_budget {
+    size_t allocs;
+    size_t peak;
+    size_t stack;
+} alloc_budget_t;
+
+typedef struct alloc_case {
+    const char* name;
+    void (*schema)(alloc_case_data_t* d);
+    void (*argv)(alloc_case_data_t* d);
+    alloc_budget_t budget[PHASES];
+} alloc_case_t;
+
+static alloc_case_t cases[] = {
+    { "small/empty",  schema_small, argv_empty,  {
+        { 16, 8192,   4096 }, { 0, 0,     1024 }, { 0, 0,    1024 }, { 16, 6144,   16384 } } },
+    { "small/values", schema_small, argv_values, {
+        { 16, 8192,   4096 }, { 4, 256,   2048 }, { 0, 0,    1024 }, { 20, 6144,   16384 } } },
+    { "small/vector", schema_small, argv_vector, {
+        { 16, 8192,   4096 }, { 4, 49152, 2048 }, { 0, 0,    1024 }, { 20, 49152,  16384 } } },
+    { "small/typos",  schema_small, argv_typos,  {
+        { 16, 8192,   4096 }, { 4, 1024,  8192 }, { 0, 0,    1024 }, { 20, 6144,   16384 } } },
+    { "rules/values", schema_rules, argv_values, {
+        { 20, 8192,   4096 }, { 4, 256,   2048 }, { 0, 0,    1024 }, { 24, 6144,   16384 } } },
+    { "large/values", schema_large, argv_large,  {
+        { 48, 196608, 4096 }, { 4, 65536, 8192 }, { 0, 0,    1024 }, { 48, 262144, 16384 } } },
+    { "enum/values",  schema_enum,  argv_enum,   {
+        { 20, 32768,  4096 }, { 4, 49152, 16384 }, { 0, 0,   1024 }, { 24, 81920,  24576 } } },
+};
+
+static int case_handler(srz_opt_type_t opt_type, const srz_opt_t* const opt, const char* const optval, void* user)
+{
+    (void)user;
+    if(opt_type == SRZ_OPT_SHORT || opt_type == SRZ_OPT_LONG || opt_type == SRZ_OPT_POS){
+        srz_store(opt, (char*)optval); //Bad values are reported, and the case carries on
+    }
+    return 0;
+}
+
+static void phase_begin(void)
+{
+    alloc_count = 0;
+    alloc_peak  = alloc_live;
+    stack_paint();
+}
+
+static bool phase_end(const alloc_case_t* c, alloc_phase_t phase, size_t base)
+{
+    const size_t stack = stack_used();
+    const size_t peak = alloc_peak - base;
+    const alloc_budget_t* budget = &c->budget[phase];
+    const bool over = alloc_count > budget->allocs || peak > budget->peak || stack > budget->stack;
+
+    printf("%-14s %-7s %6zu (%6zu) %10zu (%10zu) %8zu (%8zu) %s\n", c->name, phase_names[phase],
+           alloc_count, budget->allocs, peak, budget->peak, stack, budget->stack, over ? "OVER BUDGET" : "ok");
+    return over;
+}
+
+static void case_reset(alloc_case_data_t* d)
+{
+    srz_vec_free(dst_vec);
+    dst_vec = NULL;
+    free(d->vector);
+    memset(d, 0, sizeof(*d));
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    d->cfg = cfg;
+}
+
+//The tokens are overwritten while the values are stored, so each run gets a fresh command line
+static bool case_run(const alloc_case_t* c, alloc_case_data_t* d)
+{
+    bool over = false;
+
+    case_reset(d);
+    c->schema(d);
+    c->argv(d);
+
+    srz_stream_t* stream = NULL;
+    size_t base = alloc_live;
+    phase_begin();
+    srz_stream_open(&stream, d->opts, &d->cfg, case_handler, NULL);
+    over |= phase_end(c, PHASE_OPEN, base);
+
+    base = alloc_live;
+    phase_begin();
+    for(size_t i = 0; stream && i < d->ntoks; i++){
+        srz_feed(stream, d->toks[i]);
+    }
+    over |= phase_end(c, PHASE_FEED, base);
+
+    base = alloc_live;
+    phase_begin();
+    if(stream){
+        srz_finish(stream);
+    }
+    over |= phase_end(c, PHASE_FINISH, base);
+
+    case_reset(d);
+    c->schema(d);
+    c->argv(d);
+
+    char* argv[CASE_TOKS + 1];
+    argv[0] = "alloc";
+    memcpy(argv + 1, d->toks, d->ntoks * sizeof(char*));
+
+    base = alloc_live;
+    phase_begin();
+    srz_parse_cfg((int)d->ntoks + 1, argv, d->opts, &d->cfg, case_handler, NULL);
+    over |= phase_end(c, PHASE_PARSE, base);
+
+    case_reset(d);
+    return over;
+}
+
+
+int main(int argc, char** argv)
+{
+    const char* only = argc > 1 ? argv[1] : NULL;
+    static alloc_case_data_t data;
+    bool over = false;
+
+    printf("static: srz_t %zu bytes (bss), srz_stream_t %zu bytes (stack in srz_parse_cfg)\n",
+           sizeof(srz_t), sizeof(srz_stream_t));
+    printf("%-14s %-7s %6s (%6s) %10s (%10s) %8s (%8s)\n", "case", "phase", "allocs", "budget", "peak bytes", "budget", "stack", "budget");
+
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++){
+        if(only && strcmp(only, cases[i].name)){
+            continue;
+        }
+        over |= case_run(&cases[i], &data);
+    }
+
+    if(alloc_live){
+        printf("LEAK: %zu bytes still held\n", alloc_live);
+        over = true;
+    }
+
+    return over;
+}
@@ -0,0 +1,971 @@
+/*
+ * Shiraz benchmarks
+ * ================
+ * Pathological and large inputs, each with a generous time ceiling. A case that
+ * runs over its ceiling is a regression, and the benchmark exits non-zero. Each
+ * case also checks what it got (handler calls, suggestions, stored values), so a
+ * fast wrong answer is a mismatch and fails the same way. The library's warnings
+ * for the bad input the cases feed it go to /dev/null.
+ */
+
+#define _GNU_SOURCE //fmemopen()
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "shiraz.h"
+
+
+#define BENCH_OPTS 120
+
+
+typedef struct bench {
+    const char* name;
+    double ceiling_ms;
+    void (*run)(void);
+} bench_t;
+
+static srz_opt_t bench_opts[BENCH_OPTS + 1];
+static char bench_names[BENCH_OPTS][32];
+static char bench_shorts[BENCH_OPTS][2];
+static size_t bench_calls;
+static size_t bench_types[SRZ_OPT_CMD + 1]; //Handler calls by type
+static const char** bench_want;             //Name each call is expected to resolve to or suggest, in order, or NULL
+static size_t bench_at;
+static size_t bench_found;                  //Calls that resolved to or suggested their bench_want name
+static bool bench_bad;
+
+//A case that got the wrong answer is a mismatch, however fast it was
+static void bench_expect(bool ok, const char* fmt, ...)
+{
+    if(ok){
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    printf("    ");
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+    bench_bad = true;
+}
+
+static bool bench_has(const srz_cands_t* cands, const char* name)
+{
+    for(size_t i = 0; i < cands->count; i++){
+        if(strcmp(cands->names[i], name) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+static int bench_handler(srz_opt_type_t opt_type, const srz_opt_t* const opt, const char* const optval, void* user)
+{
+    (void)optval;
+    (void)user;
+    bench_calls++;
+    bench_types[opt_type]++;
+    if(bench_want){
+        const char* want = bench_want[bench_at++];
+        const bool known = opt_type == SRZ_OPT_SHORT || opt_type == SRZ_OPT_LONG;
+        bench_found += known ? opt && opt->lng && strcmp(opt->lng, want) == 0 : bench_has(srz_candidates(), want);
+    }
+    return 0;
+}
+
+static double bench_now_ms(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void bench_schema(void)
+{
+    static const char* words[] = { "buffer", "threads", "timeout", "verbose", "listen", "cache", "queue", "retry" };
+    const size_t nwords = sizeof(words) / sizeof(words[0]);
+
+    for(size_t i = 0; i < BENCH_OPTS; i++){
+        snprintf(bench_names[i], sizeof(bench_names[i]), "%s-%s-%zu", words[i % nwords], words[(i / nwords) % nwords], i);
+        bench_shorts[i][0] = i < 26 ? (char)('a' + i) : '\0';
+        srz_opt_t opt = SRZ_REQ((int)i, bench_shorts[i], bench_names[i], "benchmark option");
+        bench_opts[i] = opt;
+    }
+    srz_opt_t fin = SRZ_FIN;
+    bench_opts[BENCH_OPTS] = fin;
+}
+
+static void bench_parse(int argc, char** argv)
+{
+    srz_parse_ex(argc, argv, bench_opts, bench_handler, NULL);
+}
+
+
+/* A single 1MB garbage long option */
+static void bench_huge_token(void)
+{
+    const size_t len = 1024 * 1024;
+    char* tok = malloc(len + 1);
+    tok[0] = '-';
+    tok[1] = '-';
+    for(size_t i = 2; i < len; i++){
+        tok[i] = (char)('a' + (i * 7) % 26);
+    }
+    tok[len] = '\0';
+
+    char* argv[] = { "bench", tok, NULL };
+    for(int i = 0; i < 16; i++){
+        bench_parse(2, argv);
+        }
+    bench_expect(bench_types[SRZ_OPT_UNKOWN_NONE] == 16, "huge-token: expected 16 unknown options without suggestions, got %zu", bench_types[SRZ_OPT_UNKOWN_NONE]);
+    free(tok);
+}
+
+/* Tokens exactly at the fuzzy length cap, the most expensive tokens that are still matched */
+static void bench_cap_tokens(void)
+{
+    enum { COUNT = 1024 };
+    static char toks[COUNT][SRZ_FUZZY_MAX_LEN + 3];
+    char* argv[COUNT + 1];
+    argv[0] = "bench";
+    for(size_t t = 1; t < COUNT; t++){
+        toks[t][0] = '-';
+        toks[t][1] = '-';
+        for(size_t i = 0; i < SRZ_FUZZY_MAX_LEN; i++){
+            toks[t][i + 2] = bench_names[(t + i) % BENCH_OPTS][i % 8];
+        }
+        toks[t][SRZ_FUZZY_MAX_LEN + 2] = '\0';
+        argv[t] = toks[t];
+    }
+    argv[COUNT] = NULL;
+    bench_parse(COUNT, argv);
+    bench_expect(bench_calls == COUNT - 1 && bench_types[SRZ_OPT_UNKOWN_NONE] == COUNT - 1,
+                 "cap-tokens: expected %d unknown options without suggestions, got %zu of %zu calls", COUNT - 1, bench_types[SRZ_OPT_UNKOWN_NONE], bench_calls);
+}
+
+/* Thousands of near misses, every one of which needs a fuzzy match */
+static void bench_typos(void)
+{
+    enum { COUNT = 4096 };
+    static char toks[COUNT][40];
+    static const char* want[COUNT];
+    char* argv[COUNT + 1];
+    argv[0] = "bench";
+    for(size_t t = 1; t < COUNT; t++){
+        const char* name = bench_names[t % BENCH_OPTS];
+        const size_t len = strlen(name);
+        const size_t drop = t % len;
+        snprintf(toks[t], sizeof(toks[t]), "--%.*s%s", (int)drop, name, name + drop + 1);
+        argv[t] = toks[t];
+        want[t - 1] = name;
+    }
+    argv[COUNT] = NULL;
+
+    //Some typos are also prefixes of another option, without abbreviations every one is unknown
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    cfg.abbrev = false;
+    bench_want = want;
+    srz_parse_cfg(COUNT, argv, bench_opts, &cfg, bench_handler, NULL);
+    bench_expect(bench_found == COUNT - 1, "typos: %zu of %d typos suggested the option meant", bench_found, COUNT - 1);
+}
+
+/* Thousands of abbreviated long options, each a unique prefix */
+static void bench_abbrev(void)
+{
+    enum { COUNT = 4096 };
+    static char toks[COUNT][40];
+    static const char* want[COUNT / 2];
+    char* argv[COUNT + 1];
+    argv[0] = "bench";
+    for(size_t t = 1; t + 1 < COUNT; t += 2){
+        //Dropping the last digit of options 10 to 63 leaves a unique prefix
+        const char* name = bench_names[10 + t % 54];
+        snprintf(toks[t], sizeof(toks[t]), "--%.*s", (int)strlen(name) - 1, name);
+        argv[t] = toks[t];
+        argv[t + 1] = "1";
+        want[t / 2] = name;
+    }
+    argv[COUNT - 1] = NULL;
+    bench_want = want;
+    bench_parse(COUNT - 1, argv);
+    bench_expect(bench_calls == COUNT / 2 - 1 && bench_found == bench_calls,
+                 "abbrev: %zu of %d prefixes resolved to their option, in %zu calls", bench_found, COUNT / 2 - 1, bench_calls);
+}
+
+/* Near misses against a schema of thousands of options */
+static void bench_large_schema(void)
+{
+    enum { OPTS = 4096, COUNT = 1024 };
+    static srz_opt_t opts[OPTS + 1];
+    static char names[OPTS][40];
+    static char toks[COUNT][48];
+    static const char* words[] = { "pool", "size", "limit", "bytes", "depth", "timeout", "rate", "window" };
+
+    for(size_t i = 0; i < OPTS; i++){
+        snprintf(names[i], sizeof(names[i]), "%s-%s-%s-%zu", words[i % 8], words[(i / 8) % 8], words[(i / 64) % 8], i);
+        srz_opt_t opt = SRZ_REQ((int)i, "", names[i], "a description long enough to make the declaration struct matter");
+        opts[i] = opt;
+    }
+    srz_opt_t fin = SRZ_FIN;
+    opts[OPTS] = fin;
+
+    static const char* want[COUNT];
+    char* argv[COUNT + 1];
+    argv[0] = "bench";
+    for(size_t t = 1; t < COUNT; t++){
+        const char* name = names[(t * 997) % OPTS];
+        snprintf(toks[t], sizeof(toks[t]), "--%.4s%s", name, name + 5);
+        argv[t] = toks[t];
+        want[t - 1] = name;
+    }
+    argv[COUNT] = NULL;
+
+    bench_want = want;
+    srz_parse_ex(COUNT, argv, opts, bench_handler, NULL);
+    bench_expect(bench_found == COUNT - 1, "large-schema: %zu of %d typos suggested the option meant", bench_found, COUNT - 1);
+}
+
+/* Lines that all end in an option missing its argument */
+static void bench_missing_args(void)
+{
+    char first[40];
+    char last[40];
+    snprintf(first, sizeof(first), "--%s", bench_names[0]);
+    snprintf(last, sizeof(last), "--%s", bench_names[BENCH_OPTS - 1]);
+
+    char* argv_short[] = { "bench", "-a", "1", "-b", NULL };
+    char* argv_long[]  = { "bench", first, "1", last, NULL };
+
+    for(int i = 0; i < 1024; i++){
+        bench_parse(4, argv_short);
+        bench_parse(4, argv_long);
+    }
+    const size_t missing = bench_types[SRZ_OPT_ARG_MISSING_SHORT] + bench_types[SRZ_OPT_ARG_MISSING_LONG];
+    bench_expect(missing == 2048 && bench_calls == 4096, "missing-args: expected 2048 missing arguments in 4096 calls, got %zu in %zu", missing, bench_calls);
+}
+
+/* 40 subcommands of 50 options each, only the selected one is ever registered */
+enum { BENCH_CMDS = 40, BENCH_CMD_OPTS = 50 };
+static srz_opt_t bench_cmd_opts[BENCH_CMD_OPTS + 1];
+static char bench_cmd_names[BENCH_CMDS][16];
+
+static srz_opt_t* bench_cmd_reg(const srz_cmd_t* cmd, void* user)
+{
+    (void)cmd;
+    (void)user;
+    for(size_t i = 0; i < BENCH_CMD_OPTS; i++){
+        srz_opt_t opt = SRZ_REQ((int)i, "", bench_names[i], "subcommand option");
+        bench_cmd_opts[i] = opt;
+    }
+    srz_opt_t fin = SRZ_FIN;
+    bench_cmd_opts[BENCH_CMD_OPTS] = fin;
+    return bench_cmd_opts;
+}
+
+static void bench_subcommands(void)
+{
+    srz_cmd_t cmds[BENCH_CMDS + 1];
+    for(size_t c = 0; c < BENCH_CMDS; c++){
+        snprintf(bench_cmd_names[c], sizeof(bench_cmd_names[c]), "cmd%zu", c);
+        srz_cmd_t cmd = { .name = bench_cmd_names[c], .desc = "", .reg = bench_cmd_reg };
+        cmds[c] = cmd;
+    }
+    srz_cmd_t fin = SRZ_CMD_FIN;
+    cmds[BENCH_CMDS] = fin;
+
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    cfg.cmds = cmds;
+
+    char opt[40];
+    snprintf(opt, sizeof(opt), "--%s=1", bench_names[BENCH_CMD_OPTS - 1]);
+    char* argv[] = { "bench", "-a", "1", bench_cmd_names[BENCH_CMDS - 1], opt, NULL };
+    size_t errs = 0;
+    for(int i = 0; i < 1024; i++){
+        errs += srz_parse_cfg(5, argv, bench_opts, &cfg, bench_handler, NULL) != SRZ_ERR_NONE;
+    }
+    bench_expect(!errs && bench_types[SRZ_OPT_CMD] == 1024 && bench_types[SRZ_OPT_SHORT] == 1024 && bench_types[SRZ_OPT_LONG] == 1024,
+                 "subcommands: %zu errors, %zu subcommands, %zu short and %zu long options of 1024 each",
+                 errs, bench_types[SRZ_OPT_CMD], bench_types[SRZ_OPT_SHORT], bench_types[SRZ_OPT_LONG]);
+}
+
+/* Completion requests answered straight from the option table */
+static void bench_complete(void)
+{
+    char* words[] = { "--buffer-t" };
+    char out[256] = "";
+    FILE* first = fmemopen(out, sizeof(out), "w");
+    srz_complete(bench_opts, 1, words, first);
+    fclose(first);
+    bench_expect(strcmp(out, "--buffer-threads-72\n--buffer-threads-8\n--buffer-timeout-16\n--buffer-timeout-80\n") == 0, "complete: got `%s`", out);
+
+    FILE* null = fopen("/dev/null", "w");
+    for(int i = 1; i < 1024; i++){
+        srz_complete(bench_opts, 1, words, null);
+        bench_calls++;
+    }
+    fclose(null);
+}
+
+/* One token of 256k comma separated numbers, split and converted into a vector */
+static int bench_store_handler(srz_opt_type_t opt_type, const srz_opt_t* const opt, const char* const optval, void* user)
+{
+    (void)user;
+    bench_calls++;
+    return opt_type == SRZ_OPT_SHORT ? srz_store(opt, (char*)optval) : 0;
+}
+
+static void bench_delimited(void)
+{
+    enum { COUNT = 256 * 1024 };
+    char* tok = malloc(COUNT * 6 + 1);
+    size_t len = 0;
+    for(size_t i = 0; i < COUNT; i++){
+        len += (size_t)sprintf(tok + len, "%zu,", i % 65536);
+    }
+    tok[len - 1] = '\0';
+
+    uint32_t* vals = NULL;
+    srz_opt_t opts[2] = { SRZ_REQ(0, "v", "values", "delimited values"), SRZ_FIN };
+    opts[0].val.type      = SRZ_VAL_UINT32;
+    opts[0].val.is_vector = true;
+    opts[0].val.delim     = ',';
+    opts[0].val.dest      = &vals;
+
+    char* argv[] = { "bench", "-v", tok, NULL };
+    for(int i = 0; i < 4; i++){
+        srz_parse_ex(3, argv, opts, bench_store_handler, NULL);
+    }
+    bench_expect(srz_len(vals) == 4 * COUNT && vals[3 * COUNT + 70000] == 70000 % 65536,
+                 "delimited: expected %d values, got %zu", 4 * COUNT, srz_len(vals));
+
+    srz_vec_free(vals);
+    free(tok);
+}
+
+/* A long session of options and split arguments pushed through a stream in small chunks */
+static void bench_stream(void)
+{
+    enum { TOKENS = 512 * 1024, CHUNK = 61 };
+    char* data = malloc(TOKENS * 24);
+    size_t len = 0;
+    for(size_t t = 0; t < TOKENS; t += 2){
+        len += (size_t)sprintf(data + len, "--%s", bench_names[t % BENCH_OPTS]) + 1;
+        len += (size_t)sprintf(data + len, "%zu", t) + 1;
+    }
+
+    srz_stream_t* stream = NULL;
+    if(srz_stream_open(&stream, bench_opts, NULL, bench_handler, NULL)){
+        free(data);
+        return;
+    }
+    srz_errno_t err = SRZ_ERR_NONE;
+    for(size_t at = 0; at < len && !err; at += CHUNK){
+        err = srz_feed_bytes(stream, data + at, len - at < CHUNK ? len - at : CHUNK);
+    }
+    const srz_errno_t fin = srz_finish(stream);
+    err = err ? err : fin;
+    bench_expect(!err && bench_types[SRZ_OPT_LONG] == TOKENS / 2 && bench_calls == TOKENS / 2,
+                 "stream: error %d, expected %d options, got %zu in %zu calls", err, TOKENS / 2, bench_types[SRZ_OPT_LONG], bench_calls);
+    free(data);
+}
+
+/* Thousands of options and constraints, every option given and every rule checked */
+static void bench_constraints(void)
+{
+    enum { OPTS = 4096, RULES = 4096, COUNT = 16 };
+    static srz_opt_t opts[OPTS + 1];
+    static char names[OPTS][16];
+    static int idents[OPTS];
+    static srz_rule_t rules[RULES + 1];
+    static char toks[OPTS][20];
+    char* argv[OPTS + 1];
+
+    argv[0] = "bench";
+    for(size_t i = 0; i < OPTS; i++){
+        snprintf(names[i], sizeof(names[i]), "opt-%zu", i);
+        srz_opt_t opt = SRZ_FLG((int)i, "", names[i], "constrained option");
+        opts[i] = opt;
+        idents[i] = (int)i;
+        snprintf(toks[i], sizeof(toks[i]), "--%s", names[i]);
+        if(i){
+            argv[i] = toks[i];
+        }
+    }
+    srz_opt_t fin = SRZ_FIN;
+    opts[OPTS] = fin;
+
+    for(size_t r = 0; r < RULES; r++){
+        //Each option requires the 64 after it
+        const size_t first = r % (OPTS - 64);
+        srz_rule_t rule = { .type = SRZ_RULE_REQUIRES, .ident = (int)first, .idents = idents + first + 1, .count = 63 };
+        rules[r] = rule;
+    }
+    srz_rule_t rule_fin = SRZ_RULE_FIN;
+    rules[RULES] = rule_fin;
+
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    cfg.rules = rules;
+    size_t errs = 0;
+    for(int i = 0; i < COUNT; i++){
+        errs += srz_parse_cfg(OPTS, argv, opts, &cfg, bench_handler, NULL) != SRZ_ERR_NONE;
+    }
+    bench_expect(!errs && bench_types[SRZ_OPT_LONG] == COUNT * (OPTS - 1),
+                 "constraints: %zu failed parses, %zu of %d options", errs, bench_types[SRZ_OPT_LONG], COUNT * (OPTS - 1));
+}
+
+/* Throughput of unit suffixed sizes, durations and counts, 1M of each */
+static void bench_units(void)
+{
+    enum { COUNT = 1024 * 1024 };
+    static char* sizes[]     = { "64MiB", "1.5GB", "4096", "512KiB", "10EB", "3.25TiB", "100B", "7k" };
+    static char* durations[] = { "250ms", "1h30m", "10s", "1.5s", "200us", "5min", "100ns", "2h15m30s" };
+    static char* counts[]    = { "10k", "2.5M", "42", "1G", "7.125T", "3E", "999", "1.5k" };
+    static const uint64_t size_vals[]     = { 67108864, 1500000000, 4096, 524288, 10000000000000000000u, 3573412790272, 100, 7000 };
+    static const uint64_t duration_vals[] = { 250000000, 5400000000000, 10000000000, 1500000000, 200000, 300000000000, 100, 8130000000000 };
+    static const uint64_t count_vals[]    = { 10000, 2500000, 42, 1000000000, 7125000000000, 3000000000000000000, 999, 1500 };
+    const struct { srz_val_type_t type; char** vals; const uint64_t* want; } kinds[] = {
+        { SRZ_VAL_SIZE, sizes, size_vals }, { SRZ_VAL_DURATION, durations, duration_vals }, { SRZ_VAL_COUNT, counts, count_vals },
+    };
+
+    uint64_t dest = 0;
+    srz_opt_t opt = SRZ_REQ(0, "u", "units", "unit suffixed value");
+    opt.val.dest = &dest;
+    for(size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++){
+        opt.val.type = kinds[k].type;
+        for(size_t i = 0; i < COUNT; i++){
+            const srz_errno_t err = srz_store(&opt, kinds[k].vals[i % 8]);
+            if(i < 8){
+                bench_expect(!err && dest == kinds[k].want[i], "units: `%s` gave %" PRIu64 ", expected %" PRIu64,
+                             kinds[k].vals[i], dest, kinds[k].want[i]);
+            }
+            bench_calls += !err;
+        }
+    }
+    bench_expect(bench_calls == 3 * COUNT, "units: %zu of %d values converted", bench_calls, 3 * COUNT);
+}
+
+/* 4M doubles and 4M 64 bit integers in two delimited values, converted in bulk */
+static char* bench_repeat(size_t count, const char* fmt, size_t* bytes)
+{
+    enum { BLOCK = 1024 };
+    char block[BLOCK * 24];
+    size_t block_len = 0;
+    for(size_t i = 0; i < BLOCK; i++){
+        const uint64_t x = (i * 0x9E3779B97F4A7C15ULL) >> 11;
+        block_len += (size_t)(fmt[1] == 'f' ? sprintf(block + block_len, "%.6f,", (double)(x % 100000000) / 1000.0)
+                                            : sprintf(block + block_len, "%" PRIu64 ",", x));
+    }
+
+    char* tok = malloc(count / BLOCK * block_len + 1);
+    for(size_t b = 0; b < count / BLOCK; b++){
+        memcpy(tok + b * block_len, block, block_len);
+    }
+    *bytes += count / BLOCK * block_len;
+    tok[count / BLOCK * block_len - 1] = '\0';
+    return tok;
+}
+
+static void bench_bulk_numeric(void)
+{
+    enum { COUNT = 4 * 1024 * 1024 };
+    size_t bytes = 0;
+    char* doubles  = bench_repeat(COUNT, "%f", &bytes);
+    char* integers = bench_repeat(COUNT, "%u", &bytes);
+
+    double* ds = NULL;
+    uint64_t* us = NULL;
+    srz_opt_t opt = SRZ_REQ(0, "v", "values", "bulk values");
+    opt.val.is_vector = true;
+    opt.val.delim     = ',';
+
+    const double start = bench_now_ms();
+    opt.val.type = SRZ_VAL_DOUBLE;
+    opt.val.dest = &ds;
+    srz_store(&opt, doubles);
+    opt.val.type = SRZ_VAL_UINT64;
+    opt.val.dest = &us;
+    srz_store(&opt, integers);
+    const double elapsed = bench_now_ms() - start;
+
+    printf("%-16s %10.1fMB/s\n", "  conversion", bytes / 1e3 / elapsed);
+    bench_calls = srz_len(ds) + srz_len(us);
+    const uint64_t x = 0x9E3779B97F4A7C15ULL >> 11; //The second element of every block
+    bench_expect(srz_len(ds) == COUNT && srz_len(us) == COUNT && us[1025] == x && ds[1025] == (double)(x % 100000000) / 1000.0,
+                 "bulk-numeric: expected %d of each, got %zu doubles and %zu integers", COUNT, srz_len(ds), srz_len(us));
+    srz_vec_free(ds);
+    srz_vec_free(us);
+    free(doubles);
+    free(integers);
+}
+
+/* 32MB of doubles read from a binary @file: mapped once, then appended by copy */
+static void bench_binary_file(void)
+{
+    enum { COUNT = 4 * 1024 * 1024 };
+    char path[64];
+    snprintf(path, sizeof(path), "@/tmp/shiraz-bench-%ld.bin", (long)getpid());
+
+    FILE* f = fopen(path + 1, "wb");
+    if(!f){
+        return;
+    }
+    for(size_t i = 0; i < COUNT; i++){
+        const double x = (double)i * 0.5;
+        fwrite(&x, sizeof(x), 1, f);
+    }
+    fclose(f);
+
+    double* ds = NULL;
+    srz_opt_t opt = SRZ_REQ(0, "v", "values", "binary values");
+    opt.val.is_vector = true;
+    opt.val.type = SRZ_VAL_DOUBLE;
+    opt.val.dest = &ds;
+    opt.val.files = true;
+
+    const double start = bench_now_ms();
+    srz_store(&opt, path);
+    double sum = 0;
+    for(size_t i = 0; i < srz_len(ds); i++){
+        sum += ds[i];
+    }
+    const double mapped = bench_now_ms() - start;
+    srz_store(&opt, path);
+    const double elapsed = bench_now_ms() - start;
+
+    printf("%-16s %10.1fMB/s mapped and summed, %.1fMB/s appended\n", "  binary",
+           COUNT * sizeof(double) / 1e3 / mapped, COUNT * sizeof(double) / 1e3 / (elapsed - mapped));
+    bench_calls = srz_len(ds);
+    bench_expect(srz_len(ds) == 2 * COUNT && sum == (double)COUNT * (COUNT - 1) / 4 && ds[2 * COUNT - 1] == (COUNT - 1) * 0.5,
+                 "binary-file: expected %d doubles summing to %.1f, got %zu summing to %.1f", 2 * COUNT, (double)COUNT * (COUNT - 1) / 4, srz_len(ds), sum);
+    srz_vec_free(ds);
+    remove(path + 1);
+}
+
+/* Publish 1M doubles and 4096 strings once, then attach them as 64 workers would */
+static void bench_shared(void)
+{
+    enum { DOUBLES = 1024 * 1024, STRS = 4096, WORKERS = 64 };
+    static char names[STRS][16];
+    double* ds = NULL;
+    char** ss = NULL;
+    int n = 7;
+
+    srz_opt_t opts[] = {
+        SRZ_REQ(0, "n", "num", "number"),
+        SRZ_REQ(1, "d", "doubles", "doubles"),
+        SRZ_REQ(2, "s", "strings", "strings"),
+        SRZ_FIN,
+    };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_INT, .dest = &n };
+    opts[1].val = (srz_val_t){ .type = SRZ_VAL_DOUBLE, .is_vector = true, .dest = &ds };
+    opts[2].val = (srz_val_t){ .type = SRZ_VAL_STR, .is_vector = true, .dest = &ss };
+
+    for(size_t i = 0; i < DOUBLES; i++){
+        char val[32];
+        snprintf(val, sizeof(val), "%zu.5", i);
+        srz_store(&opts[1], val);
+    }
+    for(size_t i = 0; i < STRS; i++){
+        snprintf(names[i], sizeof(names[i]), "name-%zu", i);
+        srz_store(&opts[2], names[i]);
+    }
+
+    int fd = -1;
+    const double start = bench_now_ms();
+    const srz_errno_t err = srz_publish(opts, &fd);
+    const double published = bench_now_ms() - start;
+    srz_vec_free(ds);
+    srz_vec_free(ss);
+    bench_expect(!err, "shared: publish failed with %d", err);
+
+    size_t good = 0;
+    for(size_t w = 0; w < WORKERS && !err; w++){
+        ds = NULL;
+        ss = NULL;
+        n = 0;
+        if(srz_attach(opts, fd) == SRZ_ERR_NONE){
+            bench_calls += srz_len(ds) + srz_len(ss);
+            good += n == 7 && srz_len(ds) == DOUBLES && srz_len(ss) == STRS && ds[DOUBLES - 1] == DOUBLES - 0.5 && strcmp(ss[STRS - 1], names[STRS - 1]) == 0;
+            srz_detach(opts);
+        }
+    }
+    bench_expect(good == WORKERS, "shared: %zu of %d attaches saw the published values", good, WORKERS);
+    const double attached = (bench_now_ms() - start - published) / WORKERS;
+
+    printf("%-16s %10.3fms published, %.3fms per attach\n", "  shared", published, attached);
+    close(fd);
+}
+
+/* Top-5 suggestions for 1024 misspelt values of an enum with 4096 names */
+static int bench_suggest_handler(srz_opt_type_t opt_type, const srz_opt_t* const opt, const char* const optval, void* user)
+{
+    (void)user;
+    if(opt_type == SRZ_OPT_SHORT){
+        srz_cands_t cands;
+        bench_calls += srz_suggest(opt, optval, 2, 5, &cands);
+        bench_found += bench_has(&cands, bench_want[bench_at++]);
+    }
+    return 0;
+}
+
+static void bench_suggest(void)
+{
+    enum { NAMES = 4096, COUNT = 1024 };
+    static srz_enum_t map[NAMES + 1];
+    static char names[NAMES][24];
+    static char toks[COUNT][32];
+    static const char* words[] = { "north", "south", "east", "west", "up", "down", "left", "right" };
+
+    for(size_t i = 0; i < NAMES; i++){
+        snprintf(names[i], sizeof(names[i]), "%s-%s-%zu", words[i % 8], words[(i / 8) % 8], i);
+        srz_enum_t e = { .val = (int)i, .str = names[i] };
+        map[i] = e;
+    }
+    srz_enum_t fin = SRZ_ENUM_FIN;
+    map[NAMES] = fin;
+
+    int dest = 0;
+    srz_opt_t opts[] = { SRZ_REQ(0, "e", "enum", "a large enum"), SRZ_FIN };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_ENUM, .dest = &dest, .enm_map = map };
+
+    static const char* want[COUNT];
+    char* argv[COUNT + 1];
+    argv[0] = "bench";
+    for(size_t t = 1; t < COUNT; t++){
+        const char* name = names[(t * 997) % NAMES];
+        snprintf(toks[t], sizeof(toks[t]), "-e%.3s%s", name, name + 4);
+        argv[t] = toks[t];
+        want[t - 1] = name;
+    }
+    argv[COUNT] = NULL;
+
+    bench_want = want;
+    srz_parse_ex(COUNT, argv, opts, bench_suggest_handler, NULL);
+    bench_expect(bench_found == COUNT - 1, "suggest: %zu of %d misspellings suggested the name meant", bench_found, COUNT - 1);
+}
+
+/* Half a million tokens into an event array, then ordered by ident as a consumer applying dependencies would */
+static int bench_event_cmp(const void* a, const void* b)
+{
+    const srz_event_t* x = a;
+    const srz_event_t* y = b;
+    return (x->ident > y->ident) - (x->ident < y->ident);
+}
+
+static void bench_events(void)
+{
+    enum { TOKENS = 512 * 1024 };
+    char** argv = malloc((TOKENS + 1) * sizeof(char*));
+    char* data = malloc(TOKENS * 24);
+    srz_event_t* events = malloc(TOKENS / 2 * sizeof(srz_event_t));
+    size_t len = 0;
+    argv[0] = "bench";
+    for(size_t t = 1; t < TOKENS; t += 2){
+        argv[t] = data + len;
+        len += (size_t)sprintf(data + len, "--%s", bench_names[t % BENCH_OPTS]) + 1;
+        argv[t + 1] = data + len;
+        len += (size_t)sprintf(data + len, "%zu", t) + 1;
+    }
+
+    size_t count = 0;
+    const srz_errno_t err = srz_parse_events(TOKENS, argv, bench_opts, NULL, events, TOKENS / 2, &count);
+    if(err == SRZ_ERR_NONE){
+        qsort(events, count, sizeof(srz_event_t), bench_event_cmp);
+        bench_calls = count;
+    }
+    //The last option lost its value to argc, and is reported missing it. An option's event is completed by its value, the token after it.
+    size_t values = 0;
+    for(size_t e = 0; !err && e < count; e++){
+        values += events[e].type == SRZ_OPT_LONG && events[e].ident == (int)((events[e].arg - 1) % BENCH_OPTS);
+    }
+    bench_expect(!err && count == TOKENS / 2 && values == TOKENS / 2 - 1,
+                 "events: error %d, expected %d events of which %d options, got %zu and %zu", err, TOKENS / 2, TOKENS / 2 - 1, count, values);
+
+    free(events);
+    free(data);
+    free(argv);
+}
+
+/* Four config files of 64k lines each, the environment and argv, merged by precedence */
+static void bench_sources(void)
+{
+    enum { FILES = 4, LINES = 64 * 1024 };
+    char paths[FILES][64];
+    srz_source_t sources[FILES + 2];
+
+    for(size_t f = 0; f < FILES; f++){
+        snprintf(paths[f], sizeof(paths[f]), "/tmp/shiraz-bench-%ld-%zu.conf", (long)getpid(), f);
+        FILE* out = fopen(paths[f], "w");
+        if(!out){
+            return;
+        }
+        for(size_t l = 0; l < LINES; l++){
+            fprintf(out, "%s = %zu # line %zu\n", bench_names[(l * 7 + f) % BENCH_OPTS], l, l);
+        }
+        fclose(out);
+        srz_source_t src = SRZ_SRC_FILE(paths[f], false);
+        sources[f] = src;
+    }
+
+    char* argv[] = { "bench", "--", NULL };
+    srz_source_t env  = SRZ_SRC_ENV("SHIRAZ_BENCH_");
+    srz_source_t args = SRZ_SRC_ARGV(1, argv);
+    sources[FILES]     = env;
+    sources[FILES + 1] = args;
+
+    const srz_errno_t err = srz_parse_sources(sources, FILES + 2, bench_opts, NULL, bench_handler, NULL);
+    srz_sources_free();
+    //Every file gives every option, so the last file replaces all the others
+    bench_expect(!err && bench_types[SRZ_OPT_LONG] == LINES && bench_calls == LINES,
+                 "sources: error %d, expected %d options, got %zu in %zu calls", err, LINES, bench_types[SRZ_OPT_LONG], bench_calls);
+    for(size_t f = 0; f < FILES; f++){
+        remove(paths[f]);
+    }
+}
+
+/* A 1024 name enum set built from 64k +/- elements, then 16M membership tests */
+static void bench_enum_set(void)
+{
+    enum { NAMES = 1024, ELEMS = 64 * 1024, TESTS = 16 * 1024 * 1024 };
+    static srz_enum_t map[NAMES + 1];
+    static char names[NAMES][16];
+    for(size_t i = 0; i < NAMES; i++){
+        snprintf(names[i], sizeof(names[i]), "proto-%zu", i);
+        srz_enum_t e = { .val = (int)i, .str = names[i] };
+        map[i] = e;
+    }
+    srz_enum_t fin = SRZ_ENUM_FIN;
+    map[NAMES] = fin;
+
+    char* val = malloc(ELEMS * 16);
+    size_t len = (size_t)sprintf(val, "all");
+    for(size_t i = 1; i < ELEMS; i++){
+        len += (size_t)sprintf(val + len, ",%c%s", i % 3 ? '-' : '+', names[(i * 31) % NAMES]);
+    }
+
+    srz_ens_t set = { 0 };
+    srz_opt_t opts[] = { SRZ_REQ(0, "p", "proto", "enabled protocols"), SRZ_FIN };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_ENUM_SET, .dest = &set, .enm_map = map, .delim = ',' };
+    char* argv[] = { "bench", "-p", val, NULL };
+    srz_parse_ex(3, argv, opts, bench_store_handler, NULL);
+
+    size_t hits = 0;
+    for(size_t t = 0; t < TESTS; t++){
+        hits += srz_ens_has(&set, (int)(t * 2654435761u % NAMES));
+    }
+    bench_calls = hits + srz_ens_count(&set);
+
+    //The same +/- elements applied one by one
+    bool want[NAMES];
+    size_t count = 0, wrong = 0;
+    for(size_t n = 0; n < NAMES; n++){
+        want[n] = true;
+    }
+    for(size_t i = 1; i < ELEMS; i++){
+        want[(i * 31) % NAMES] = i % 3 == 0;
+    }
+    for(size_t n = 0; n < NAMES; n++){
+        count += want[n];
+        wrong += want[n] != srz_ens_has(&set, (int)n);
+    }
+    bench_expect(!wrong && srz_ens_count(&set) == count, "enum-set: %zu of %d names wrong, %zu in the set, expected %zu",
+                 wrong, NAMES, srz_ens_count(&set), count);
+    srz_ens_free(&set);
+    free(val);
+}
+
+/* 1M repeats of four numeric options streamed with last-wins, only the final values get converted */
+static void bench_last_wins(void)
+{
+    enum { TOKENS = 1024 * 1024, OPTS = 4 };
+    double vals[OPTS] = { 0 };
+    srz_opt_t opts[OPTS + 1] = {
+        SRZ_REQ(0, "a", "alpha", "alpha"), SRZ_REQ(0, "b", "beta", "beta"),
+        SRZ_REQ(0, "g", "gamma", "gamma"), SRZ_REQ(0, "d", "delta", "delta"), SRZ_FIN
+    };
+    for(size_t i = 0; i < OPTS; i++){
+        opts[i].val = (srz_val_t){ .type = SRZ_VAL_DOUBLE, .dest = vals + i };
+    }
+
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    cfg.last_wins = true;
+    srz_stream_t* stream = NULL;
+    if(srz_stream_open(&stream, opts, &cfg, bench_store_handler, NULL)){
+        return;
+    }
+    char tok[32];
+    for(size_t t = 0; t < TOKENS; t++){
+        snprintf(tok, sizeof(tok), "-%s%zu.5", opts[t % OPTS].srt, t);
+        srz_feed(stream, tok);
+    }
+    const srz_errno_t err = srz_finish(stream);
+    for(size_t i = 0; i < OPTS; i++){
+        const double want = TOKENS - OPTS + i + 0.5;
+        bench_expect(!err && vals[i] == want, "last-wins: error %d, expected %f, got %f", err, want, vals[i]);
+    }
+    bench_expect(bench_calls == OPTS, "last-wins: expected %d handler calls, got %zu", OPTS, bench_calls);
+}
+/* 32k options in a three level dotted namespace, each given once and its whole scope fetched */
+static const srz_opt_t* bench_scope_out[64];
+
+static int bench_scope_handler(srz_opt_type_t opt_type, const srz_opt_t* const opt, const char* const optval, void* user)
+{
+    (void)optval;
+    (void)user;
+    if(opt_type == SRZ_OPT_LONG){
+        char scope[32];
+        const size_t len = (size_t)(strrchr(opt->lng, '.') - opt->lng);
+        memcpy(scope, opt->lng, len);
+        scope[len] = '\0';
+        bench_calls += srz_scope_opts(scope, bench_scope_out, 64);
+    }
+    return 0;
+}
+
+static void bench_scopes(void)
+{
+    enum { OPTS = 32 * 1024 };
+    static srz_opt_t opts[OPTS + 1];
+    static char names[OPTS][32];
+    static char toks[OPTS][40];
+    static char* argv[OPTS + 1];
+
+    for(size_t i = 0; i < OPTS; i++){
+        snprintf(names[i], sizeof(names[i]), "svc%zu.pool%zu.key%zu", i / 1024, (i / 32) % 32, i % 32);
+        srz_opt_t opt = SRZ_REQ((int)i, "", names[i], "scoped");
+        opts[i] = opt;
+    }
+    srz_opt_t fin = SRZ_FIN;
+    opts[OPTS] = fin;
+
+    argv[0] = "bench";
+    for(size_t t = 1; t < OPTS; t++){
+        snprintf(toks[t], sizeof(toks[t]), "--%s=1", names[(t * 7919) % OPTS]);
+        argv[t] = toks[t];
+    }
+
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    srz_parse_cfg(OPTS, argv, opts, &cfg, bench_scope_handler, NULL);
+    bench_expect(bench_calls == (OPTS - 1) * 32, "scopes: expected %d scoped options, got %zu", (OPTS - 1) * 32, bench_calls);
+}
+/* 256 hostile requests of 1M typo tokens each, cut short by per-parse limits */
+static void bench_limits(void)
+{
+    enum { REQUESTS = 256, COUNT = 1024 * 1024 };
+    static char toks[BENCH_OPTS][40];
+    static char* argv[COUNT + 1];
+    argv[0] = "bench";
+    for(size_t t = 0; t < BENCH_OPTS; t++){
+        const char* name = bench_names[t];
+        snprintf(toks[t], sizeof(toks[t]), "--%.*sx%s", (int)(t % strlen(name)), name, name + t % strlen(name) + 1);
+    }
+    for(size_t t = 1; t < COUNT; t++){
+        argv[t] = toks[t % BENCH_OPTS];
+    }
+
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    cfg.limits = (srz_limits_t){ .tokens = 4096, .bytes = 64 * 1024, .memory = 64 * 1024, .fuzzy = 16 * 1024 };
+    size_t stopped = 0;
+    for(size_t r = 0; r < REQUESTS; r++){
+        const srz_errno_t err = srz_parse_cfg(COUNT, argv, bench_opts, &cfg, bench_handler, NULL);
+        stopped += err == SRZ_ERR_LIMIT_TOKENS || err == SRZ_ERR_LIMIT_BYTES || err == SRZ_ERR_LIMIT_MEMORY;
+    }
+    bench_expect(stopped == REQUESTS, "limits: %zu of %d hostile requests stopped", stopped, REQUESTS);
+    bench_expect(bench_calls < REQUESTS * cfg.limits.tokens, "limits: %zu handler calls past the token limit", bench_calls);
+}
+/* Help for 1536 options with long descriptions, 64 times in full and 64 times one section of it */
+static void bench_help(void)
+{
+    enum { OPTS = 1536, RUNS = 64 };
+    static srz_opt_t opts[OPTS + 1];
+    static char names[OPTS][32];
+    static const char* desc = "Set the limit for this component. The value is checked against the other "
+                              "limits of the same group when the configuration is loaded, and an error is "
+                              "reported at startup if the combination cannot be satisfied by the host.";
+    for(size_t i = 0; i < OPTS; i++){
+        snprintf(names[i], sizeof(names[i]), "group%zu.option-%zu", i / 64, i);
+        srz_opt_t opt = SRZ_REQ((int)i, "", names[i], (char*)desc);
+        opts[i] = opt;
+    }
+    srz_opt_t fin = SRZ_FIN;
+    opts[OPTS] = fin;
+
+    const int fd = open("/dev/null", O_WRONLY);
+    if(fd < 0){
+        return;
+    }
+    for(size_t r = 0; r < RUNS; r++){
+        bench_calls += srz_help(opts, "bench", NULL, fd) == SRZ_ERR_NONE;
+        bench_calls += srz_help(opts, "bench", "group7", fd) == SRZ_ERR_NONE;
+    }
+    close(fd);
+    bench_expect(bench_calls == 2 * RUNS, "help: %zu of %d runs succeeded", bench_calls, 2 * RUNS);
+}
+
+static bench_t benches[] = {
+    { "huge-token",   50.0,  bench_huge_token   },
+    { "cap-tokens",   250.0, bench_cap_tokens   },
+    { "typos",        250.0, bench_typos        },
+    { "abbrev",       50.0,  bench_abbrev       },
+    { "large-schema", 500.0, bench_large_schema },
+    { "missing-args", 100.0, bench_missing_args },
+    { "subcommands",  100.0, bench_subcommands  },
+    { "complete",     250.0, bench_complete     },
+    { "delimited",    250.0, bench_delimited    },
+    { "stream",       250.0, bench_stream       },
+    { "constraints",  500.0, bench_constraints  },
+    { "units",        500.0, bench_units        },
+    { "bulk-numeric", 1000.0, bench_bulk_numeric },
+    { "binary-file",  1000.0, bench_binary_file  },
+    { "shared",       1000.0, bench_shared       },
+    { "suggest",      250.0,  bench_suggest      },
+    { "events",       250.0,  bench_events       },
+    { "sources",      500.0,  bench_sources      },
+    { "enum-set",     250.0,  bench_enum_set     },
+    { "last-wins",    250.0,  bench_last_wins    },
+    { "scopes",       250.0,  bench_scopes       },
+    { "limits",       500.0,  bench_limits       },
+    { "help",         250.0,  bench_help         },
+    { NULL, 0, NULL },
+};
+
+
+int main(int argc, char** argv)
+{
+    const char* only = argc > 1 ? argv[1] : NULL;
+    int failed = 0;
+
+    bench_schema();
+
+    //The cases feed the library bad input on purpose, its warnings would bury the results
+    fflush(stderr);
+    const int null = open("/dev/null", O_WRONLY);
+    if(null >= 0){
+        dup2(null, STDERR_FILENO);
+        close(null);
+    }
+
+    for(bench_t* b = benches; b->name; b++){
+        if(only && strcmp(only, b->name)){
+            continue;
+        }
+
+        bench_calls = 0;
+        memset(bench_types, 0, sizeof(bench_types));
+        bench_want  = NULL;
+        bench_at    = 0;
+        bench_found = 0;
+        bench_bad   = false;
+        const double start = bench_now_ms();
+        b->run();
+        const double elapsed = bench_now_ms() - start;
+        const bool over = elapsed > b->ceiling_ms;
+
+        printf("%-16s %10.3fms (ceiling %8.1fms, %zu handler calls) %s\n",
+               b->name, elapsed, b->ceiling_ms, bench_calls, over ? "REGRESSION" : bench_bad ? "MISMATCH" : "ok");
+        failed |= over || bench_bad;
+    }
+
+    return failed;
+}
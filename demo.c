@@ -1,6 +1,6 @@
 #include <stdio.h>
 
-#define SRZ_DEBUG
+#define SRZ_DEBUG 1
 #include "shiraz.h"
 
 
@@ -17,6 +17,12 @@ srz_enum_t test_e_map[] = {
     {BLUE,  "BLUE"},
 };
 
+static int verbose = 0;
+#if SRZ_SECTION
+//Registered at link time, srz_parse() picks it up without an srz_add_*() call
+SRZ_DEFINE_FLG(verbose, "v", "verbose", "more output", &verbose);
+#endif
+
 
 int main( int argc, char** argv)
 {
@@ -34,8 +40,15 @@ int main( int argc, char** argv)
     srz_pos("s", "positionals", "some positionals",     &pos                    );
     srz_enm("e", "enum",        "an enum",              &enm,  RED, test_e_map  );
     srz_ens("E", "enums",       "enums",                &enms, test_e_map       );
+    srz_delim(',');
+#if !SRZ_SECTION
+    srz_flg("v", "verbose",     "more output",          &verbose                );
+#endif
 
     srz_parse(argc, argv);
+    if(verbose){
+        printf("verbose\n");
+    }
 
     return 0;
 }
@@ -0,0 +1,11 @@
+/*
+ * Shiraz library build
+ * ================
+ * The one translation unit libshiraz.a and libshiraz.so are built from (make lib).
+ * Programs linking against them define SRZ_HONLY before including shiraz.h, so
+ * they get the declarations only, and the build time parameters that change the
+ * implementation (SRZ_PARALLEL, SRZ_MMAP, SRZ_HARD_EXIT, the allocator hooks...)
+ * are the ones the library was built with.
+ */
+
+#include "shiraz.h"
@@ -51,8 +51,10 @@
 #include <libgen.h>
 #include <unistd.h>
 #include <stdbool.h>
-#include <getopt.h>
-#include <getopt.h>
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <sys/uio.h>
 
 
 /*
@@ -73,6 +75,115 @@
 #define SRZ_DEBUG 0 //If this is set, debug printing is enabled
 #endif
 
+#ifndef SRZ_FUZZY_MAX_LEN
+#define SRZ_FUZZY_MAX_LEN 64 //Tokens longer than this are never fuzzy matched
+#endif
+
+#ifndef SRZ_FUZZY_MAX_DIST
+#define SRZ_FUZZY_MAX_DIST 4 //Maximum edit distance for a fuzzy match to be considered close
+#endif
+
+#ifndef SRZ_FUZZY_BUDGET
+#define SRZ_FUZZY_BUDGET (64 * 1024) //Maximum name characters compared per fuzzy match
+#endif
+
+#ifndef SRZ_COMPLETION
+#define SRZ_COMPLETION 0 //If this is set, the hidden shell completion options are handled by srz_parse_ex(), which then exits
+#endif
+
+#ifndef SRZ_PARALLEL
+#define SRZ_PARALLEL 1 //If this is set, very large delimited vector values are converted by several threads
+#endif
+
+#ifndef SRZ_PARALLEL_MIN
+#define SRZ_PARALLEL_MIN (1024 * 1024) //Smallest value, in bytes, that is converted by more than one thread
+#endif
+
+#ifndef SRZ_THREADS
+#define SRZ_THREADS 0 //Threads used for a parallel conversion, 0 for one per online CPU
+#endif
+
+#define SRZ_THREADS_MAX 64 //Maximum number of threads used to convert a single value
+
+#ifndef SRZ_SECTION
+#if defined(__GNUC__) && defined(__ELF__)
+#define SRZ_SECTION 1 //If this is set, srz_parse() also takes the options placed in the srz_opts linker section by SRZ_DEFINE_*()
+#else
+#define SRZ_SECTION 0
+#endif
+#endif
+
+#ifndef SRZ_HELP_WIDTH
+#define SRZ_HELP_WIDTH 80 //Help descriptions are wrapped to this many columns
+#endif
+
+#ifndef SRZ_HELP_COL_MAX
+#define SRZ_HELP_COL_MAX 32 //Option names longer than this put their help description on the next line
+#endif
+
+#ifndef SRZ_ENUM_HASH_MIN
+#define SRZ_ENUM_HASH_MIN 16 //Enum maps with at least this many names are looked up through a hash table
+#endif
+
+#ifndef SRZ_ENS_MAX
+#define SRZ_ENS_MAX 65536 //Enum set values must be below this, it bounds the bitset at 8KB
+#endif
+
+#ifndef SRZ_MALLOC
+//Allocator hooks, every byte Shiraz allocates goes through these. Define all four to replace them.
+#define SRZ_MALLOC(size)        malloc(size)
+#define SRZ_CALLOC(count, size) calloc(count, size)
+#define SRZ_REALLOC(ptr, size)  realloc(ptr, size)
+#define SRZ_FREE(ptr)           free(ptr)
+#endif
+
+#ifndef SRZ_COLD
+#if defined(__GNUC__)
+#define SRZ_COLD __attribute__((cold)) //Error, suggestion and completion code, kept out of the hot text (.text.unlikely)
+#else
+#define SRZ_COLD
+#endif
+#endif
+
+#ifndef SRZ_USDT
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define SRZ_USDT 1 //If this is set, the parser carries USDT probes for perf and bpftrace, each a single nop until a tracer attaches
+#endif
+#endif
+#endif
+#ifndef SRZ_USDT
+#define SRZ_USDT 0
+#endif
+
+#if SRZ_USDT
+#include <sys/sdt.h>
+#define SRZ_PROBE(name, ...) STAP_PROBEV(shiraz, name, __VA_ARGS__) //Every probe takes at least one argument
+#else
+#define SRZ_PROBE(name, ...) ((void)0)
+#endif
+
+#if SRZ_PARALLEL
+#include <threads.h>
+#endif
+
+#ifndef SRZ_MMAP
+#define SRZ_MMAP 1 //If this is set, a vector value of the form @path maps a raw binary file into the destination, for options that opt in
+#endif
+
+#if SRZ_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
+#define SRZ_COMPLETE_ARG        "--srz-complete"          //Hidden option, print completions for the words that follow
+#define SRZ_COMPLETE_SCRIPT_ARG "--srz-completion-script" //Hidden option, print a static completion script for bash or zsh
+#define SRZ_COMPLETE_MAX 256 //Longest word that will be offered as a completion
+
+#define SRZ_CMDS_MAX  64 //Maximum number of subcommands registered with srz_cmd()
+#define SRZ_CANDS_MAX 16 //Maximum number of candidates reported for an ambiguous option
+
 #define SRZ_SOPTS_MAX 256 //Maximum number of charters to use for short options
 #define SRZ_LOPTS_MAX 128 //Maximum number of long options
 #define SRZ_OPTS_MAX  SRZ_LOPTS_MAX //Maximum number of options in total. Should not be less than SRZ_LOPTS_MAX
@@ -106,6 +217,10 @@ typedef enum {
     SRZ_VAL_DOUBLE,
     SRZ_VAL_STR,
     SRZ_VAL_ENUM,
+    SRZ_VAL_SIZE,     //Bytes as uint64_t, e.g. "64MiB", "1.5GB"
+    SRZ_VAL_DURATION, //Nanoseconds as uint64_t, e.g. "250ms", "1h30m"
+    SRZ_VAL_COUNT,    //uint64_t with an SI scale, e.g. "10k"
+    SRZ_VAL_ENUM_SET, //srz_ens_t, one bit per value of the enum map
 } srz_val_type_t;
 
 typedef enum {
@@ -119,13 +234,39 @@ typedef enum {
     SRZ_OPT_ARG_MISSING_NONE,
     SRZ_OPT_ARG_MISSING_LONG,
     SRZ_OPT_ARG_MISSING_SHORT,
+    SRZ_OPT_AMBIGUOUS_LONG, //Prefix of several long options, the candidates are in srz_candidates()
+    SRZ_OPT_CMD,            //A subcommand was selected, optval is its name and opt is NULL
 } srz_opt_type_t;
 
+//Enum maps are terminated with SRZ_ENUM_FIN. srz_enm() and srz_ens() also take
+//an unterminated array, and terminate a copy of it.
 typedef struct srz_enum {
     int val;
     char* str;
 } srz_enum_t;
 
+#define SRZ_ENUM_FIN { .val = 0, .str = NULL }
+
+//Entries in an array map, 0 for a pointer, which must then be terminated
+#define SRZ_ENUM_COUNT(map) ((sizeof(map) + 0) / sizeof(srz_enum_t))
+
+//map if it ends in SRZ_ENUM_FIN within count entries, or with count 0. Otherwise
+//a terminated copy, kept for the life of the process. NULL if out of memory.
+srz_enum_t* srz_enum_fin(srz_enum_t* map, size_t count);
+
+//A set of enum values, as a bitset indexed by value. Values are "name", "+name",
+//"-name", "all" or "none", applied in order. Map names "all" and "none" take
+//precedence over the keywords. The bits are allocated on the first value, sized from the map.
+typedef struct srz_ens {
+    uint64_t* bits;
+    size_t size;    //One more than the largest value in the map
+} srz_ens_t;
+
+static inline bool srz_ens_has(const srz_ens_t* set, int val)
+{
+    return val >= 0 && (size_t)val < set->size && (set->bits[val / 64] >> (val % 64) & 1);
+}
+
 typedef struct srz_val {
     srz_val_type_t type;
     bool is_vector;
@@ -140,6 +281,8 @@ typedef struct srz_val {
     void* dest;
 
     srz_enum_t* enm_map;
+    char delim; //Splits each value of a vector option into elements, '\0' for none
+    bool files; //A value of the form @path is a binary file to read, see srz_store()
 } srz_val_t;
 
 typedef enum {
@@ -194,10 +337,10 @@ typedef struct srz_option {
 
 /*
  * ******** !!!! WARNING !!!! ********
- * Long options (and by GNU extension short options as well) **can** support "optional" arguments.
+ * Long and short options **can** support "optional" arguments.
  * Seriously!! Don't use this feature! There's lots of reasons:
  * - It is likely to cause confusion to users when it's done wrong.
- * - Only long options are supported widely (GNU extension for short optionals)
+ * - Other parsers often only support them on long options (getopt only has short optionals as a GNU extension)
  * - Only "=" assignment is supported (not spaces) for long opts, only no space is supported for short opts
  * */
 #define SRZ_OPT(IDENT, SHORT, LONG, DESCR) \
@@ -217,7 +360,7 @@ typedef enum {
     SRZ_ERR_NONE = 0,
     SRZ_ERR_SOPTS_MAX_TOO_SMALL,
     SRZ_ERR_SOPT_DUP,
-    SRZ_ERR_SOPT_OPTIONAL,
+    SRZ_ERR_SOPT_OPTIONAL,      //No longer returned, short options may take an optional argument
     SRZ_ERR_SOPT_TOO_LONG,
     SRZ_ERR_LOPT_DUP,
     SRZ_ERR_LOPTS_MAX_TOO_SMALL,
@@ -229,6 +372,30 @@ typedef enum {
     SRZ_ERR_NO_SHORT_LONG,
     SRZ_ERR_OPTS_MAX_TOO_SMALL,
     SRZ_ERR_NO_OPTS_ADDED,
+    SRZ_ERR_NOMEM,
+    SRZ_ERR_UNKNOWN_SHELL,
+    SRZ_ERR_CMDS_MAX_TOO_SMALL,
+    SRZ_ERR_BAD_VALUE,
+    SRZ_ERR_VALUE_RANGE,
+    SRZ_ERR_DELIM_SCALAR,
+    SRZ_ERR_RULE_IDENT,
+    SRZ_ERR_CONSTRAINT,
+    SRZ_ERR_FILE,
+    SRZ_ERR_FILE_SIZE,
+    SRZ_ERR_FILE_TYPE,
+    SRZ_ERR_SHARED,
+    SRZ_ERR_SHARED_LAYOUT,
+    SRZ_ERR_EVENTS_MAX_TOO_SMALL,
+    SRZ_ERR_SOURCE,
+    SRZ_ERR_ENS_VALUE,
+    SRZ_ERR_SCOPE,
+    SRZ_ERR_LIMIT_TOKENS,
+    SRZ_ERR_LIMIT_BYTES,
+    SRZ_ERR_LIMIT_ELEMS,
+    SRZ_ERR_LIMIT_MEMORY,
+    SRZ_ERR_HELP_SECTION,
+    SRZ_ERR_WRITE,
+    SRZ_ERR_DELIM_FLOAT,
     SRZ_ERR_LAST, //Last error code, use this as a base for custom errors
 } srz_errno_t;
 
@@ -238,11 +405,269 @@ typedef struct srz_error_en {
 } srz_err_t;
 
 
+struct srz_cmd;
+
+/*
+ * Constraints between options, by ident, checked once parsing finishes. A rule
+ * naming an option that is not in the table is an error, unless subcommands are
+ * configured, in which case it only applies to tables that have all its options.
+ */
+typedef enum {
+    SRZ_RULE_REQUIRED,  //Every one of idents must be given
+    SRZ_RULE_REQUIRES,  //If ident is given, every one of idents must be given too
+    SRZ_RULE_CONFLICTS, //If ident is given, none of idents may be given
+    SRZ_RULE_ONE_OF,    //Exactly one of idents must be given
+} srz_rule_type_t;
+
+//Rule lists are terminated with SRZ_RULE_FIN
+typedef struct srz_rule {
+    srz_rule_type_t type;
+    int ident;
+    const int* idents;
+    size_t count;
+    bool fin;
+} srz_rule_t;
+
+#define _SRZ_IDENTS(...) .idents = (const int[]){ __VA_ARGS__ }, .count = sizeof((const int[]){ __VA_ARGS__ }) / sizeof(int)
+#define SRZ_REQUIRED(...)          { .type = SRZ_RULE_REQUIRED,  .ident = 0,     _SRZ_IDENTS(__VA_ARGS__) }
+#define SRZ_REQUIRES(IDENT, ...)   { .type = SRZ_RULE_REQUIRES,  .ident = IDENT, _SRZ_IDENTS(__VA_ARGS__) }
+#define SRZ_CONFLICTS(IDENT, ...)  { .type = SRZ_RULE_CONFLICTS, .ident = IDENT, _SRZ_IDENTS(__VA_ARGS__) }
+#define SRZ_ONE_OF(...)            { .type = SRZ_RULE_ONE_OF,    .ident = 0,     _SRZ_IDENTS(__VA_ARGS__) }
+#define SRZ_RULE_FIN { .fin = true }
+
+/*
+ * Per parse resource limits, for command lines from untrusted sources. 0 is no
+ * limit. A parse that hits one stops and returns its SRZ_ERR_LIMIT_* code, it
+ * prints nothing and never exits. Fuzzy work is the exception: once it is spent,
+ * unknown options and bad enum values simply get no suggestions. Sources apply
+ * the limits to each source on its own. Setting any limit also turns off @file
+ * values and the completion hook, so untrusted input cannot read files or end
+ * the program.
+ */
+typedef struct srz_limits {
+    size_t tokens;              //Tokens fed
+    size_t bytes;               //Bytes of all tokens, including a partial one being streamed
+    size_t elems;               //Elements in any one vector
+    size_t memory;              //Bytes the parse adds to vectors, enum sets and its own buffers
+    size_t fuzzy;               //Name characters compared for suggestions, see SRZ_FUZZY_BUDGET
+} srz_limits_t;
+
+//Per schema parse configuration
+typedef struct srz_cfg {
+    bool abbrev;                //Accept unambiguous prefixes of long options
+    bool last_wins;             //Only the last occurrence of a repeated scalar option reaches the handler, once the parse ends
+    const struct srz_cmd* cmds; //Subcommands, terminated with SRZ_CMD_FIN, or NULL
+    const srz_rule_t* rules;    //Constraints, terminated with SRZ_RULE_FIN, or NULL
+    srz_limits_t limits;
+} srz_cfg_t;
+
+#define SRZ_CFG_DEFAULT { .abbrev = true }
+
+//Candidate options for an ambiguous or unknown option, valid during the handler call.
+//Unknown options are ranked closest first, by edit distance from the name given.
+typedef struct srz_cands {
+    const srz_opt_t* opts[SRZ_CANDS_MAX];
+    const char* names[SRZ_CANDS_MAX];   //The name that matched: long, short or enum
+    size_t dist[SRZ_CANDS_MAX];         //Edit distance, 0 for an exact match or a prefix
+    size_t count;
+} srz_cands_t;
+
+/*
+ * Subcommands (git-style). The first positional that names a subcommand selects
+ * it, and only then is its registration function run. It returns the options
+ * table for the rest of the command line, or NULL to carry on with the current
+ * table, which it may have extended with srz_add_*() and friends. A returned
+ * table is merged with the current one, so global options still resolve after
+ * the subcommand, unless the subcommand has an option of the same name. The
+ * handler then gets pointers into the merged copy, with the same idents.
+ */
+typedef srz_opt_t* (* srz_cmd_reg_t)(const struct srz_cmd* cmd, void* user);
+
+typedef struct srz_cmd {
+    const char* name;
+    const char* desc;
+    srz_cmd_reg_t reg;
+} srz_cmd_t;
+
+#define SRZ_CMD_FIN { .name = NULL }
+
 typedef int (* srz_opt_handler_t)(srz_opt_type_t opt_type, const srz_opt_t* const opt, const char* const optval, void* user);
 srz_errno_t srz_parse_ex(int argc, char** argv, srz_opt_t* opts, srz_opt_handler_t opt_handler, void* user);
+srz_errno_t srz_parse_cfg(int argc, char** argv, srz_opt_t* opts, const srz_cfg_t* cfg, srz_opt_handler_t opt_handler, void* user);
+const srz_cands_t* srz_candidates(void);
+//With cfg.last_wins, the number of earlier occurrences dropped for the option being handled
+size_t srz_overrides(void);
+
+/*
+ * Events. srz_parse_events() resolves argv without calling back, writing one
+ * fixed size event per handler call srz_parse_cfg() would have made. The value
+ * is argv[arg] + off, len bytes long and '\0' terminated, or absent when off is
+ * SRZ_EVENT_NOVAL. arg is the token that completed the event, so for unknown
+ * options it is the offending token. ident is 0 for events without an option
+ * (SRZ_OPT_CMD, SRZ_OPT_UNKOWN_NONE). The events needed are returned in count
+ * even when that is more than max, in which case the parse fails after writing
+ * the first max of them. Subcommand registration functions are still called.
+ */
+#define SRZ_EVENT_NOVAL UINT32_MAX
+
+typedef struct srz_event {
+    int ident;
+    srz_opt_type_t type;
+    uint32_t arg;
+    uint32_t off;
+    uint32_t len;
+} srz_event_t;
+
+srz_errno_t srz_parse_events(int argc, char** argv, srz_opt_t* opts, const srz_cfg_t* cfg, srz_event_t* events, size_t max, size_t* count);
+
+/*
+ * Sources. srz_parse_sources() combines argv, the environment and config files,
+ * listed lowest precedence first (the destination defaults are below them all).
+ * Each source is read, tokenized and resolved on a thread of its own, and the
+ * handler is then called on the calling thread, source by source, for every
+ * option except those a later source gives too: a later source replaces an
+ * earlier one's values rather than adding to them. Constraints are checked on
+ * the merged result. Subcommands are not supported. The text of environment and
+ * file sources is kept, as string values point into it, until srz_sources_free().
+ */
+typedef enum {
+    SRZ_SOURCE_ARGV,
+    SRZ_SOURCE_ENV,  //PREFIX_LOG_LEVEL=3 is --log-level=3 and PREFIX_DB__POOL_SIZE=8 is --db.pool-size=8, a flag is given unless its value is empty, 0, false, no or off.
+                     //With a NULL or empty prefix only variables that name an option are read, the rest are skipped rather than reported unknown.
+    SRZ_SOURCE_FILE, //One "name = value", "name value" or "name" per line, '#' starts a comment, "[db.pool]" scopes the names after it
+} srz_source_type_t;
+
+typedef struct srz_source {
+    srz_source_type_t type;
+    int argc;           //argv[0] is the program name, as for srz_parse_ex()
+    char** argv;
+    const char* prefix;
+    const char* path;
+    bool optional;      //A file that does not exist is skipped
+} srz_source_t;
+
+#define SRZ_SRC_ARGV(ARGC, ARGV)      { .type = SRZ_SOURCE_ARGV, .argc = ARGC, .argv = ARGV }
+#define SRZ_SRC_ENV(PREFIX)           { .type = SRZ_SOURCE_ENV,  .prefix = PREFIX }
+#define SRZ_SRC_FILE(PATH, OPTIONAL)  { .type = SRZ_SOURCE_FILE, .path = PATH, .optional = OPTIONAL }
+
+srz_errno_t srz_parse_sources(const srz_source_t* sources, size_t count, srz_opt_t* opts, const srz_cfg_t* cfg, srz_opt_handler_t opt_handler, void* user);
+//Release the text kept by every srz_parse_sources() so far, and the strings srz_feed_bytes()
+//copied. String values stored from them must no longer be used. Safe to call between parses.
+void srz_sources_free(void);
+//Rank the names closest to tok, at most max_dist edits away, into the first k of cands.
+//With opt NULL the names are the option names (tok without dashes), otherwise the enum
+//names of opt. Uses the schema being parsed, so is only valid during a handler call.
+size_t srz_suggest(const srz_opt_t* opt, const char* tok, size_t max_dist, size_t k, srz_cands_t* cands);
+//Put up to max of the options whose long names are under the dotted scope path (e.g. "cache"
+//for --cache.l2.bytes, "" for all) into out, in name order, and return how many there are.
+//Costs the size of the scope, not the schema. Only valid during a handler call, as above.
+size_t srz_scope_opts(const char* path, const srz_opt_t** out, size_t max);
+
+/*
+ * Streaming. Tokens are pushed one at a time as they arrive, e.g. over a pipe, and
+ * each option is handled as soon as it is complete. srz_feed() takes a single
+ * writable token. srz_feed_bytes() takes arbitrary chunks of '\0' terminated
+ * tokens (as in /proc/self/cmdline), and a token or an option and its argument
+ * may be split across chunks. Values passed to the handler are only valid for
+ * the duration of the call. srz_store() keeps pointers to string values, so those
+ * of options with a dest are copied out of the stream's buffers first, and kept
+ * until srz_sources_free(). srz_finish() reports an argument still missing and
+ * releases the stream.
+ */
+typedef struct srz_stream srz_stream_t;
+srz_errno_t srz_stream_open(srz_stream_t** stream, srz_opt_t* opts, const srz_cfg_t* cfg, srz_opt_handler_t opt_handler, void* user);
+srz_errno_t srz_feed(srz_stream_t* stream, char* token);
+srz_errno_t srz_feed_bytes(srz_stream_t* stream, const char* buf, size_t len);
+srz_errno_t srz_finish(srz_stream_t* stream);
+//The subcommand selected by the last parse, or NULL
+const srz_cmd_t* srz_command(void);
+//The first constraint broken by the last parse, or NULL
+const srz_rule_t* srz_violation(void);
 
 int srz_parse(int argc, char** argv);
 
+#if SRZ_SECTION
+/*
+ * Link time registration. SRZ_DEFINE_*() defines a static option at file scope
+ * and places a pointer to it in the srz_opts section, so libraries can declare
+ * their own options without an init function. srz_parse() appends every option
+ * the program was linked with to the srz_add_*() table, in link order. Nothing
+ * runs before main(): the destination's own initializer is the default value.
+ * NAME only has to be unique within its translation unit.
+ */
+#define SRZ_DEFINE(NAME, ATYPE, SHORT, LONG, DESCR, TYPE, DEST, VEC, DELIM, MAP)                      \
+    static const srz_opt_t _srz_def_##NAME = {                                                       \
+        .atype = ATYPE, .srt = SHORT, .lng = LONG, .desc = DESCR,                                   \
+        .val = { .type = TYPE, .dest = DEST, .is_vector = VEC, .delim = DELIM, .enm_map = MAP },    \
+    };                                                                                               \
+    static const srz_opt_t* const _srz_defp_##NAME __attribute__((used, section("srz_opts"))) = &_srz_def_##NAME
+
+#define SRZ_DEFINE_FLG(NAME, SHORT, LONG, DESCR, DEST)          SRZ_DEFINE(NAME, SRZ_ARG_NON, SHORT, LONG, DESCR, SRZ_VAL_INT,      DEST, false, '\0', NULL)
+#define SRZ_DEFINE_INT(NAME, SHORT, LONG, DESCR, DEST)          SRZ_DEFINE(NAME, SRZ_ARG_REQ, SHORT, LONG, DESCR, SRZ_VAL_INT,      DEST, false, '\0', NULL)
+#define SRZ_DEFINE_U64(NAME, SHORT, LONG, DESCR, DEST)          SRZ_DEFINE(NAME, SRZ_ARG_REQ, SHORT, LONG, DESCR, SRZ_VAL_UINT64,   DEST, false, '\0', NULL)
+#define SRZ_DEFINE_DBL(NAME, SHORT, LONG, DESCR, DEST)          SRZ_DEFINE(NAME, SRZ_ARG_REQ, SHORT, LONG, DESCR, SRZ_VAL_DOUBLE,   DEST, false, '\0', NULL)
+#define SRZ_DEFINE_STR(NAME, SHORT, LONG, DESCR, DEST)          SRZ_DEFINE(NAME, SRZ_ARG_REQ, SHORT, LONG, DESCR, SRZ_VAL_STR,      DEST, false, '\0', NULL)
+#define SRZ_DEFINE_SIZE(NAME, SHORT, LONG, DESCR, DEST)         SRZ_DEFINE(NAME, SRZ_ARG_REQ, SHORT, LONG, DESCR, SRZ_VAL_SIZE,     DEST, false, '\0', NULL)
+#define SRZ_DEFINE_DUR(NAME, SHORT, LONG, DESCR, DEST)          SRZ_DEFINE(NAME, SRZ_ARG_REQ, SHORT, LONG, DESCR, SRZ_VAL_DURATION, DEST, false, '\0', NULL)
+#define SRZ_DEFINE_ENUM(NAME, SHORT, LONG, DESCR, DEST, MAP)    SRZ_DEFINE(NAME, SRZ_ARG_REQ, SHORT, LONG, DESCR, SRZ_VAL_ENUM,     DEST, false, '\0', MAP)
+#define SRZ_DEFINE_ENS(NAME, SHORT, LONG, DESCR, DEST, MAP)     SRZ_DEFINE(NAME, SRZ_ARG_REQ, SHORT, LONG, DESCR, SRZ_VAL_ENUM_SET, DEST, false, ',',  MAP)
+//A vector of TYPE (an srz_val_type_t), split at DELIM unless it is '\0'
+#define SRZ_DEFINE_VEC(NAME, SHORT, LONG, DESCR, TYPE, DEST, DELIM) SRZ_DEFINE(NAME, SRZ_ARG_REQ, SHORT, LONG, DESCR, TYPE,           DEST, true,  DELIM, NULL)
+#endif
+
+/*
+ * Values. srz_parse() stores every option value it sees with srz_store(), custom
+ * handlers may do the same. Vector destinations are allocated by Shiraz, grow as
+ * values are appended, and are released with srz_vec_free().
+ */
+//Convert optval to the option type and store it in the destination. Vector options
+//append, and if the option has a delimiter each element of optval is appended. String
+//elements point into optval, which has its delimiters overwritten with '\0'. optval is
+//modified in place: with srz_parse() that is the caller's argv, so pass a copy of
+//argv if it is needed intact afterwards.
+//For a numeric vector with val.files set, a value of the form @path reads the raw little
+//endian elements of a binary file, any other value is converted as usual. If the vector
+//is empty the destination points straight into a private mapping of the file. A parse
+//with any limit set takes @path as an ordinary value.
+srz_errno_t srz_store(const srz_opt_t* opt, char* optval);
+//Number of elements in a vector destination, 0 for NULL
+size_t srz_len(const void* vec);
+void srz_vec_free(void* vec);
+
+#if SRZ_MMAP
+/*
+ * Shared values. A supervisor parses once and publishes the values of its options
+ * table into an anonymous shared memory file, laid out with offsets so it maps
+ * anywhere. Workers with the same table attach the file read only: strings and
+ * numeric vectors point into the shared pages, string vectors get a small private
+ * array of pointers, and scalars are copied out. Passing opts as NULL uses the
+ * table built with srz_add_*(). The descriptor is inherited by fork() but closed
+ * on exec(). Attached values must not be written to, grown or freed, they stay
+ * mapped until srz_detach(). A file that does not match the table is refused
+ * before anything is bound.
+ */
+srz_errno_t srz_publish(const srz_opt_t* opts, int* fd);
+srz_errno_t srz_attach(const srz_opt_t* opts, int fd);
+//Unmap the file last attached to opts, and set the strings and vectors bound from it to NULL
+srz_errno_t srz_detach(const srz_opt_t* opts);
+#endif
+
+typedef enum {
+    SRZ_SHELL_BASH,
+    SRZ_SHELL_ZSH,
+} srz_shell_t;
+
+//Print the completions of the last word in words[] (the word under the cursor), one per line
+srz_errno_t srz_complete(const srz_opt_t* opts, int nwords, char** words, FILE* out);
+//Write a static completion script for prog, so completion does not need to run prog at all
+srz_errno_t srz_completion_script(const srz_opt_t* opts, const char* prog, srz_shell_t shell, FILE* out);
+
+//Write the help for opts to fd (e.g. STDOUT_FILENO): a usage line, then each option's names
+//and argument in a column with its description wrapped beside it. With a section, e.g. the
+//value of --help=net, only the options under that dotted scope are rendered. The text is
+//built in one buffer and written with a single writev(). prog may be NULL (an empty argv).
+srz_errno_t srz_help(const srz_opt_t* opts, const char* prog, const char* section, int fd);
+
 #define _srz_add_x(n,T) \
     int srz_add_##n(char* sopt, char* lopt, char* desc, T* dest, T init)
 
@@ -300,31 +725,87 @@ _srz_add_xX(s, S, char*);
               )(sopt, lopt, descr, dest)
 #endif
 
+int srz_add_n(char* sopt, char* lopt, char* desc, int* dest);
+
+//type is SRZ_VAL_SIZE, SRZ_VAL_DURATION or SRZ_VAL_COUNT
+int srz_add_z(char* sopt, char* lopt, char* desc, uint64_t* dest, uint64_t init, srz_val_type_t type);
+#define srz_size(sopt, lopt, desc, dest, init) \
+    srz_add_z(sopt, lopt, desc, dest, init, SRZ_VAL_SIZE)
+#define srz_dur(sopt, lopt, desc, dest, init) \
+    srz_add_z(sopt, lopt, desc, dest, init, SRZ_VAL_DURATION)
+#define srz_cnt(sopt, lopt, desc, dest, init) \
+    srz_add_z(sopt, lopt, desc, dest, init, SRZ_VAL_COUNT)
 #define srz_flg(sopt, lopt, desc, dest) \
-    srz_add_i(sopt, lopt, desc, dest, 0)
+    srz_add_n(sopt, lopt, desc, dest)
 
 int srz_add_e(char* sopt, char* lopt, char* desc, int* dest, int init, srz_enum_t* map);
 #define srz_enm(sopt, lopt, desc, dest, init, map) \
-    srz_add_e(sopt, lopt, desc, dest, init, map)
+    srz_add_e(sopt, lopt, desc, dest, init, srz_enum_fin(map, SRZ_ENUM_COUNT(map)))
 
 int srz_add_E(char* sopt, char* lopt, char* desc, int** dest, srz_enum_t* map);
+int srz_add_es(char* sopt, char* lopt, char* desc, srz_ens_t* dest, srz_enum_t* map);
+#if __STDC__==1 && __STDC_VERSION__ >= 201112L
+//Repeated enum values, as a vector of int or as a set
+#define srz_ens(sopt, lopt, desc, dest, map) _Generic( (dest), \
+              int**: srz_add_E,                                \
+              srz_ens_t*: srz_add_es                           \
+              )(sopt, lopt, desc, dest, srz_enum_fin(map, SRZ_ENUM_COUNT(map)))
+#else
 #define srz_ens(sopt, lopt, desc, dest, map) \
-    srz_add_E(sopt, lopt, desc, dest, map)
+    srz_add_E(sopt, lopt, desc, dest, srz_enum_fin(map, SRZ_ENUM_COUNT(map)))
+#endif
+
+//Number of values in an enum set
+size_t srz_ens_count(const srz_ens_t* set);
+//Smallest value in an enum set above val, or -1. Start with val -1.
+int srz_ens_next(const srz_ens_t* set, int val);
+void srz_ens_free(srz_ens_t* set);
 
 int srz_add_P(char* sopt, char* lopt, char* desc, char*** dest);
 #define srz_pos(sopt, lopt, desc, dest) \
     srz_add_P(sopt, lopt, desc, dest)
 
+//Split each value of the last option added into elements at delim, e.g. "80,443,8080".
+//Floating point vectors take punctuation only, strtod() would read the rest.
+int srz_delim(char delim);
+
+//Let the last option added, a numeric vector, read values of the form @path from binary files
+int srz_files(void);
+
+//Put the long names of the options added from now on under a dotted scope path,
+//e.g. after srz_scope("db.pool"), "size" is --db.pool.size. NULL or "" ends it.
+//path is not copied.
+int srz_scope(const char* path);
+
+//Register a subcommand whose options are only added (by reg) if it is selected
+int srz_cmd(const char* name, const char* desc, srz_cmd_reg_t reg);
+
 
 
 typedef struct srz {
     srz_opt_t opts[SRZ_OPTS_MAX];
-    srz_errno_t errno;
+    srz_errno_t err_no; //Was errno, which broke any file that also included <errno.h>
     bool init_complete;
     size_t opt_idx;
     bool help;
+    srz_cfg_t cfg;
+    srz_cands_t cands;
+    srz_cmd_t cmds[SRZ_CMDS_MAX + 1];
+    size_t cmd_idx;
+    const srz_cmd_t* cmd;
+    const struct srz_schema* schema; //Schema being parsed, valid during handler calls
+    const srz_rule_t* violation;
+    char* texts;                     //Text of environment and file sources and strings copied out of streams, chained through their first bytes
+    char* kept;                      //Scoped names and terminated enum map copies, chained the same way, never freed
+    const char* scope;               //Scope path srz_add_*() puts long names under, or NULL
+    bool section_done;               //The SRZ_DEFINE_*() options have been added to opts
+    size_t overrides;                //Occurrences dropped for the option being handled, with cfg.last_wins
+    struct srz_shared_map* shared;   //Files bound by srz_attach(), most recent first
 } srz_t;
 
+//Configuration used by srz_parse()
+srz_cfg_t* srz_cfg(void);
+
 extern  srz_t ___srz___;
 
 /*
@@ -350,10 +831,34 @@ static struct srz_error_en srz_error_en[] = {
     {SRZ_ERR_NO_SHORT_LONG,       "Neither a short or long option string were supplied. Both cannot be blank. Either a short or long option string is required"},
     {SRZ_ERR_OPTS_MAX_TOO_SMALL,  "The options memory space is too small, reduce the number of options in use or enlarge SRZ_OPTS_MAX and recompile" },
     {SRZ_ERR_NO_OPTS_ADDED,       "No Shiraz options have been added. Use szr_opt(), srz_vec(), srz_flg() and related functions to add options"},
+    {SRZ_ERR_NOMEM,               "Memory allocation failed"},
+    {SRZ_ERR_UNKNOWN_SHELL,       "Unknown shell for the completion script. Valid values are bash and zsh"},
+    {SRZ_ERR_CMDS_MAX_TOO_SMALL,  "The subcommands memory space is too small, try enlarging SRZ_CMDS_MAX and recompiling" },
+    {SRZ_ERR_BAD_VALUE,           "The option value could not be converted to the option type"},
+    {SRZ_ERR_VALUE_RANGE,         "The option value is out of range for the option type"},
+    {SRZ_ERR_DELIM_SCALAR,        "A delimiter can only be set on a vector option. Use srz_vec(), srz_ens() or srz_pos()"},
+    {SRZ_ERR_RULE_IDENT,          "A constraint names an option ident that is not in the options table"},
+    {SRZ_ERR_CONSTRAINT,          "The options given break a constraint, see srz_violation()"},
+    {SRZ_ERR_FILE,                "The binary value file could not be opened or mapped"},
+    {SRZ_ERR_FILE_SIZE,           "The binary value file size is not a multiple of the option element size"},
+    {SRZ_ERR_FILE_TYPE,           "Binary value files need a fixed width numeric vector option on a little endian host"},
+    {SRZ_ERR_SHARED,              "The shared values file could not be created, written or mapped"},
+    {SRZ_ERR_SHARED_LAYOUT,       "The shared values file does not match the options table. Publish and attach with the same table"},
+    {SRZ_ERR_EVENTS_MAX_TOO_SMALL, "The events array is too small for the command line, parse again with at least the count returned"},
+    {SRZ_ERR_SOURCE,              "A source could not be read. Check the path of a config file, or mark it optional"},
+    {SRZ_ERR_ENS_VALUE,           "An enum set map value is negative or too large. Use values from 0, or enlarge SRZ_ENS_MAX and recompile"},
+    {SRZ_ERR_SCOPE,               "A scope path is one or more names separated by single dots, e.g. \"db.pool\""},
+    {SRZ_ERR_LIMIT_TOKENS,        "Too many tokens for cfg.limits.tokens"},
+    {SRZ_ERR_LIMIT_BYTES,         "The tokens are too long in total for cfg.limits.bytes"},
+    {SRZ_ERR_LIMIT_ELEMS,         "Too many elements in one vector for cfg.limits.elems"},
+    {SRZ_ERR_LIMIT_MEMORY,        "The parse needs more memory than cfg.limits.memory"},
+    {SRZ_ERR_HELP_SECTION,        "No option is under this help section. Sections are the dotted scopes of the long names"},
+    {SRZ_ERR_WRITE,               "The output could not be written"},
+    {SRZ_ERR_DELIM_FLOAT,         "This delimiter can be part of a floating point number. Use a punctuation character such as ',' or ':'"},
     {0,                           0 }
 };
 
-const char* srz_err2str_en(srz_errno_t err_no)
+SRZ_COLD const char* srz_err2str_en(srz_errno_t err_no)
 {
     for(srz_err_t* e = srz_error_en; e->err_str; e++ ){
         if(e->err_no == err_no){
@@ -379,21 +884,20 @@ typedef enum {
 #endif
 
 
-#ifdef SRZ_DEBUG
-    #define SRZ_FAIL( /*format, args*/...)  srz_err_helper(__VA_ARGS__, "")
-    #define srz_err_helper(format, ...) _srz_msg(SRZ_MSG_ERR, __LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
-    #define SRZ_WARN( /*format, args*/...)  srz_warn_helper(__VA_ARGS__, "")
-    #define srz_warn_helper(format, ...) _srz_msg(SRZ_MSG_WARN,__LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
+#define SRZ_FAIL( /*format, args*/...)  srz_err_helper(__VA_ARGS__, "")
+#define srz_err_helper(format, ...) _srz_msg(SRZ_MSG_ERR, __LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
+#define SRZ_WARN( /*format, args*/...)  srz_warn_helper(__VA_ARGS__, "")
+#define srz_warn_helper(format, ...) _srz_msg(SRZ_MSG_WARN,__LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
+
+#if SRZ_DEBUG
     #define SRZ_DBG( /*format, args*/...)  srz_debug_helper(__VA_ARGS__, "")
     #define srz_debug_helper(format, ...) _srz_msg(SRZ_MSG_DBG,__LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
 #else
-    #define SRZ_FAIL( /*format, args*/...)
-    #define SRZ_WARN( /*format, args*/...)
     #define SRZ_DBG( /*format, args*/...)
 #endif
 
 //__attribute__ ((format (printf, 5, 6)))
-static inline void _srz_msg(srz_dbg_e mode, int ln, const char* fn, const char* fu, const char* msg, ...)
+SRZ_COLD static inline void _srz_msg(srz_dbg_e mode, int ln, const char* fn, const char* fu, const char* msg, ...)
 {
     va_list args;
     va_start(args, msg);
@@ -420,7 +924,7 @@ static inline int isempty(const char* s)
     if(s == NULL){
         return 1;
     }
-    if(strlen(s) == 0){
+    if(s[0] == '\0'){
         return 1;
     }
 
@@ -428,521 +932,4577 @@ static inline int isempty(const char* s)
 }
 
 
-static inline srz_opt_t* _srz_find_short(srz_opt_t opts[], char s)
-{
-    for(srz_opt_t* opt = opts; !opt->fin; opt++){
-        const char* srt = opt->srt;
-        if(isempty(srt)){
-            continue;
-        }
+/*
+ * Slices and interned names
+ * ===========================================================================
+ * Names are passed around as a pointer and a length, and compared length first.
+ * At schema compile time every option and enum name is measured exactly once
+ * and copied into a pool as a 32 bit length, the characters and a '\0'.
+ */
 
-        if(strlen(srt) > 1){
-            continue; //This is really a long option in disguise
-        }
+typedef struct srz_slice {
+    const char* str;
+    size_t len;
+} srz_slice_t;
 
-        if(srt[0] == s){
-            return opt;
-        }
-    }
+static inline srz_slice_t _srz_slice(const char* str, size_t len)
+{
+    srz_slice_t slice = { .str = str, .len = len };
+    return slice;
+}
 
-    return NULL;
+static inline bool _srz_slice_eq(srz_slice_t a, srz_slice_t b)
+{
+    return a.len == b.len && memcmp(a.str, b.str, a.len) == 0;
 }
 
-static inline srz_opt_t* _srz_find_long(srz_opt_t opts[], const char* l, int* ignore)
+typedef struct srz_pool {
+    char* buf;
+    size_t len;
+    size_t size;
+} srz_pool_t;
+
+#define SRZ_POOL_NONE UINT32_MAX
+
+//Intern str, returning its offset in the pool, or SRZ_POOL_NONE if out of memory
+static inline uint32_t _srz_pool_add(srz_pool_t* pool, const char* str, size_t len)
 {
-    for(srz_opt_t* opt = opts; !opt->fin; opt++){
-        if(ignore && opt->ident == *ignore){
-            continue;
-        }
-        const char* lng = opt->lng;
-        if(isempty(lng)){
-            continue;
-        }
+    const size_t need = sizeof(uint32_t) + len + 1;
+    if(len > UINT32_MAX || pool->len + need >= SRZ_POOL_NONE){
+        return SRZ_POOL_NONE;
+    }
 
-        if(strcmp(l,lng) == 0){
-            return opt;
+    if(pool->len + need > pool->size){
+        size_t size = pool->size ? pool->size : 1024;
+        while(size < pool->len + need){
+            size *= 2;
         }
+        char* buf = SRZ_REALLOC(pool->buf, size);
+        if(!buf){
+            return SRZ_POOL_NONE;
+        }
+        pool->buf  = buf;
+        pool->size = size;
     }
 
-    return NULL;
+    const uint32_t off = (uint32_t)pool->len;
+    const uint32_t len32 = (uint32_t)len;
+    memcpy(pool->buf + off, &len32, sizeof(len32));
+    memcpy(pool->buf + off + sizeof(len32), str, len);
+    pool->buf[off + sizeof(len32) + len] = '\0';
+    pool->len += need;
+
+    return off;
 }
 
+static inline srz_slice_t _srz_pool_get(const srz_pool_t* pool, uint32_t off)
+{
+    uint32_t len;
+    memcpy(&len, pool->buf + off, sizeof(len));
+    return _srz_slice(pool->buf + off + sizeof(len), len);
+}
+
+static inline void _srz_pool_free(srz_pool_t* pool)
+{
+    SRZ_FREE(pool->buf);
+    memset(pool, 0, sizeof(srz_pool_t));
+}
 
-/*
- * The following code greatfully borrowed thanks to Titus Wormer
- *
- * (The MIT License)
- *
- * Copyright (c) 2015 Titus Wormer <tituswormer@gmail.com>
- *
- * Permission is hereby granted, free of charge, to any person obtaining
- * a copy of this software and associated documentation files (the
- * 'Software'), to deal in the Software without restriction, including
- * without limitation the rights to use, copy, modify, merge, publish,
- * distribute, sublicense, and/or sell copies of the Software, and to
- * permit persons to whom the Software is furnished to do so, subject to
- * the following conditions:
- *
- * The above copyright notice and this permission notice shall be
- * included in all copies or substantial portions of the Software.
- */
 
-static inline size_t _srz_levenshtein_n(const char* a, const size_t length, const char* b, const size_t bLength)
+static inline bool _srz_is_enum_type(srz_val_type_t type)
 {
-    // Shortcut optimizations / degenerate cases.
-    if(a == b){
-        return 0;
-    }
+    return type == SRZ_VAL_ENUM || type == SRZ_VAL_ENUM_SET;
+}
 
-    if(length == 0){
-        return bLength;
+static inline int _srz_ctz64(uint64_t x)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    int result = 0;
+    for(; !(x & 1); x >>= 1){
+        result++;
     }
+    return result;
+#endif
+}
 
-    if(bLength == 0){
-        return length;
+static inline int _srz_popcount64(uint64_t x)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(x);
+#else
+    int result = 0;
+    for(; x; x &= x - 1){
+        result++;
     }
+    return result;
+#endif
+}
 
-    size_t* cache = calloc(length, sizeof(size_t));
-    size_t index = 0;
-    size_t bIndex = 0;
-    size_t distance;
-    size_t bDistance;
-    size_t result;
-    char code;
-
-    // initialize the vector.
-    while(index < length){
-        cache[index] = index + 1;
-        index++;
+//Cheap 64 bucket character signature. Each bucket present in one string but not in
+//the other costs at least one edit, which gives a lower bound on the edit distance.
+static inline uint64_t _srz_sig(const char* s, size_t len)
+{
+    uint64_t sig = 0;
+    for(size_t i = 0; i < len; i++){
+        sig |= 1ULL << ((unsigned char)s[i] & 63);
     }
+    return sig;
+}
 
-    // Loop.
-    while(bIndex < bLength){
-        code = b[bIndex];
-        result = distance = bIndex++;
-        index = SIZE_MAX;
+/*
+ * Compressed prefix trie
+ * ===========================================================================
+ * Nodes live in one growable array and refer to each other by index. Each edge
+ * carries a label, a slice of the trie's own copy of the inserted keys, so a
+ * lookup costs O(key length) regardless of the number of keys. Siblings are
+ * kept sorted by their first character, so walks visit words alphabetically.
+ */
 
-        while(++index < length){
-            bDistance = code == a[index] ? distance : distance + 1;
-            distance = cache[index];
+typedef struct srz_trie_node {
+    int32_t child;          //First child, or -1
+    int32_t next;           //Next sibling, or -1
+    uint32_t label;         //Offset of the edge label in the pool
+    uint32_t len;           //Length of the edge label
+    uint32_t words;         //Number of words in this subtree
+    bool term;              //A word ends at this node
+    const srz_opt_t* opt;   //The option for a terminal node, NULL otherwise
+} srz_trie_node_t;
+
+typedef struct srz_trie {
+    srz_trie_node_t* nodes;
+    size_t count;
+    size_t size;
+    char* pool;
+    size_t pool_len;
+    size_t pool_size;
+} srz_trie_t;
+
+static inline const char* _srz_trie_label(const srz_trie_t* trie, int32_t node)
+{
+    return trie->pool + trie->nodes[node].label;
+}
 
-            cache[index] = result = distance > result
-                                    ? bDistance > result
-                                      ? result + 1
-                                      : bDistance
-                                    : bDistance > distance
-                                      ? distance + 1
-                                      : bDistance;
+static inline int32_t _srz_trie_new_node(srz_trie_t* trie, size_t label, size_t len)
+{
+    if(trie->count == trie->size){
+        const size_t size = trie->size ? trie->size * 2 : 64;
+        srz_trie_node_t* nodes = SRZ_REALLOC(trie->nodes, size * sizeof(srz_trie_node_t));
+        if(!nodes){
+            return -1;
         }
+        trie->nodes = nodes;
+        trie->size  = size;
     }
 
-    free(cache);
+    srz_trie_node_t* node = trie->nodes + trie->count;
+    node->child = -1;
+    node->next  = -1;
+    node->label = (uint32_t)label;
+    node->len   = (uint32_t)len;
+    node->words = 0;
+    node->term  = false;
+    node->opt   = NULL;
 
-    return result;
+    return (int32_t)trie->count++;
 }
 
-static inline size_t _srz_levenshtein(const char* a, const char* b)
+static inline srz_errno_t _srz_trie_init(srz_trie_t* trie)
 {
-    const size_t length = strlen(a);
-    const size_t bLength = strlen(b);
-
-    return _srz_levenshtein_n(a, length, b, bLength);
+    memset(trie, 0, sizeof(srz_trie_t));
+    return _srz_trie_new_node(trie, 0, 0) < 0 ? SRZ_ERR_NOMEM : SRZ_ERR_NONE;
 }
 
-
-//Fuzzy search to try and find the best match for an option
-static inline srz_opt_t* _srz_fuzzy_find_opt(srz_opt_t opts[], const char* s, srz_opt_type_t* opt_type_o)
+static inline void _srz_trie_free(srz_trie_t* trie)
 {
-    //Trivial escape
-    if(isempty(s)){
-        //We're never going to match anything
-        *opt_type_o = SRZ_OPT_NONE;
-        return NULL;
-    }
+    SRZ_FREE(trie->nodes);
+    SRZ_FREE(trie->pool);
+    memset(trie, 0, sizeof(srz_trie_t));
+}
 
-    //Try an exact match for the short string
-    srz_opt_t* result = NULL;
-    if(strlen(s) == 1){
-        result = _srz_find_short(opts,s[0]);
-        if(result){
-            *opt_type_o = SRZ_OPT_SHORT;
-            return result;
+//Find the child of node whose label starts with c, or -1
+static inline int32_t _srz_trie_child(const srz_trie_t* trie, int32_t node, char c)
+{
+    for(int32_t i = trie->nodes[node].child; i >= 0; i = trie->nodes[i].next){
+        const unsigned char first = (unsigned char)_srz_trie_label(trie, i)[0];
+        if(first == (unsigned char)c){
+            return i;
+        }
+        if(first > (unsigned char)c){
+            break;
         }
     }
 
-    //Try an exact match for the long string
-    result = _srz_find_long(opts,s,NULL);
-    if(result){
-        *opt_type_o = SRZ_OPT_LONG;
-        return result;
-    }
+    return -1;
+}
 
-    //Maybe it's a short option with a dash?
-    if(strlen(s) == 2 && s[1] == '-'){
-        result = _srz_find_short(opts,s[1]);
-        if(result){
-            *opt_type_o = SRZ_OPT_SHORT;
-            return result;
+//Insert key. If the key is already present it is left alone and *dup is set.
+static inline srz_errno_t _srz_trie_insert(srz_trie_t* trie, const char* key, size_t len, const srz_opt_t* opt, bool* dup)
+{
+    if(trie->pool_len + len > trie->pool_size){
+        size_t size = trie->pool_size ? trie->pool_size : 256;
+        while(size < trie->pool_len + len){
+            size *= 2;
         }
-    }
-
-    //Maybe it's a long option with one dash?
-    if(strlen(s) > 2 && s[1] == '-' ){
-        result = _srz_find_long(opts, s+1, NULL);
-        if(result){
-            *opt_type_o = SRZ_OPT_LONG;
-            return result;
+        char* pool = SRZ_REALLOC(trie->pool, size);
+        if(!pool){
+            return SRZ_ERR_NOMEM;
         }
+        trie->pool      = pool;
+        trie->pool_size = size;
     }
 
-    //Maybe it's a long option with two dashes?
-    if(strlen(s) > 3 && s[1] == '-' && s[2] == '-'){
-        result = _srz_find_long(opts, s+2, NULL);
-        if(result){
-            *opt_type_o = SRZ_OPT_LONG;
-            return result;
+    const size_t off = trie->pool_len;
+    memcpy(trie->pool + off, key, len);
+    trie->pool_len += len;
+    key = trie->pool + off;
+
+    int32_t node = 0;
+    size_t k = 0;
+    while(k < len){
+        const unsigned char c = (unsigned char)key[k];
+
+        int32_t prev = -1;
+        int32_t i = trie->nodes[node].child;
+        while(i >= 0 && (unsigned char)_srz_trie_label(trie, i)[0] < c){
+            prev = i;
+            i = trie->nodes[i].next;
         }
-    }
-
-    //We've tried hard to find an exact match, now try fuzzy matching
 
-    size_t best_match_lev = ~0;
-    srz_opt_t* best_match = NULL;
-    *opt_type_o = SRZ_OPT_NONE;
-
-    for(srz_opt_t* opt = opts; !opt->fin; opt++){
-        const char* lng = opt->lng;
-        const char* srt = opt->srt;
-
-        if(!isempty(lng)){
-            const size_t match = _srz_levenshtein(lng,s);
-            if(match < best_match_lev){
-                best_match_lev = match;
-                best_match = opt;
-                *opt_type_o = SRZ_OPT_LONG;
+        if(i < 0 || (unsigned char)_srz_trie_label(trie, i)[0] != c){
+            const int32_t n = _srz_trie_new_node(trie, off + k, len - k);
+            if(n < 0){
+                return SRZ_ERR_NOMEM;
+            }
+            trie->nodes[n].next = i;
+            if(prev < 0){
+                trie->nodes[node].child = n;
             }
+            else{
+                trie->nodes[prev].next = n;
+            }
+            node = n;
+            break;
         }
 
-        if(!isempty(srt)){
-            const size_t match = _srz_levenshtein(srt,s);
-            if(match < best_match_lev){
-                best_match_lev = match;
-                best_match = opt;
-                *opt_type_o = SRZ_OPT_SHORT;
+        //Longest common prefix of the edge label and the rest of the key
+        const char* label = _srz_trie_label(trie, i);
+        size_t common = 1;
+        while(common < trie->nodes[i].len && k + common < len && label[common] == key[k + common]){
+            common++;
+        }
+
+        if(common < trie->nodes[i].len){
+            //The key leaves the edge part way along, split it
+            const int32_t mid = _srz_trie_new_node(trie, trie->nodes[i].label, common);
+            if(mid < 0){
+                return SRZ_ERR_NOMEM;
+            }
+            trie->nodes[mid].child = i;
+            trie->nodes[mid].next  = trie->nodes[i].next;
+            trie->nodes[mid].words = trie->nodes[i].words;
+            trie->nodes[i].next    = -1;
+            trie->nodes[i].label  += common;
+            trie->nodes[i].len    -= common;
+            if(prev < 0){
+                trie->nodes[node].child = mid;
+            }
+            else{
+                trie->nodes[prev].next = mid;
             }
+            i = mid;
         }
+
+        node = i;
+        k += common;
     }
 
-    return best_match;
-}
+    if(trie->nodes[node].term){
+        if(dup){
+            *dup = true;
+        }
+        return SRZ_ERR_NONE;
+    }
 
-static inline int _srz_positional_count(srz_opt_t opts[])
-{
-    int result = 0;
-    for(srz_opt_t* opt = opts; !opt->fin; opt++){
+    trie->nodes[node].term = true;
+    trie->nodes[node].opt  = opt;
 
-        if(opt->atype == SRZ_ARG_POS){
-            result++;
-        }
+    //Count the new word on every node along its path
+    node = 0;
+    trie->nodes[0].words++;
+    for(k = 0; k < len; k += trie->nodes[node].len){
+        node = _srz_trie_child(trie, node, key[k]);
+        trie->nodes[node].words++;
     }
 
-    return result;
+    return SRZ_ERR_NONE;
 }
 
-static inline srz_opt_t* _srz_get_positional(srz_opt_t opts[])
+//Walk key down from the root. Returns the first node whose path covers all of key,
+//or -1 if no word starts with key. If rest is given, it is set to the number of
+//label characters of that node left over past the end of the key.
+static inline int32_t _srz_trie_find(const srz_trie_t* trie, const char* key, size_t len, size_t* rest)
 {
-    for(srz_opt_t* opt = opts; !opt->fin; opt++){
+    int32_t node = 0;
+    size_t k = 0;
+    if(rest){
+        *rest = 0;
+    }
 
-        if(opt->atype == SRZ_ARG_POS){
-            return opt;
+    while(k < len){
+        const int32_t i = _srz_trie_child(trie, node, key[k]);
+        if(i < 0){
+            return -1;
+        }
+
+        const size_t label_len = trie->nodes[i].len;
+        const size_t n = label_len < len - k ? label_len : len - k;
+        if(memcmp(_srz_trie_label(trie, i), key + k, n)){
+            return -1;
+        }
+
+        node = i;
+        k += n;
+        if(n < label_len && rest){
+            *rest = label_len - n;
         }
     }
 
-    return NULL;
+    return node;
 }
 
-static inline int _srz_no_short_long(srz_opt_t opts[])
+//Collect the options of up to max words below node
+static inline size_t _srz_trie_collect(const srz_trie_t* trie, int32_t node, const srz_opt_t** out, size_t count, size_t max)
 {
-    for(srz_opt_t* opt = opts; !opt->fin; opt++){
-        if(opt->atype != SRZ_ARG_POS){
-            if(isempty(opt->srt) && isempty(opt->lng)){
-                return 1;
-            }
-        }
+    if(count < max && trie->nodes[node].term){
+        out[count++] = trie->nodes[node].opt;
     }
 
-    return 0;
-}
+    for(int32_t i = trie->nodes[node].child; i >= 0 && count < max; i = trie->nodes[i].next){
+        count = _srz_trie_collect(trie, i, out, count, max);
+    }
 
+    return count;
+}
 
-static inline srz_errno_t _srz_build_short_opts(srz_opt_t opts[], char* short_opts_str)
-{
-    short_opts_str[0] = '-'; //Handle positional arguments in place
-    short_opts_str[1] = ':'; //Cause ":" to be returned on missing arg
-    int i = 1;
 
-    for(srz_opt_t* opt = opts; !opt->fin; opt++){
+/*
+ * Compiled schema
+ * ===========================================================================
+ * Lookup structures built from an options table once per parse. srz_opt_t is
+ * the declaration format, but it is too fat to scan. Names are interned in a
+ * pool and reached through the long name trie, the short name index and the
+ * BK-tree, and the options themselves (descriptions, values, enum maps) are
+ * only touched on a hit.
+ */
+
+//A run of entries in a flat array
+typedef struct srz_span {
+    uint32_t first;
+    uint32_t count;
+} srz_span_t;
+
+#define _SRZ_BK_NONE UINT32_MAX
+
+//A name in a BK-tree, see _srz_bk_search()
+typedef struct srz_bk_node {
+    uint64_t sig;       //Character signature of the name, see _srz_sig()
+    uint32_t off;       //Pool offset of the name
+    uint32_t idx;       //Option index, or index into the option's enum map
+    uint32_t child;     //First child, or _SRZ_BK_NONE
+    uint32_t sibling;   //Next child of the same parent, or _SRZ_BK_NONE
+    uint16_t dist;      //Edit distance to the parent
+    uint16_t reach;     //Largest edit distance to a child, 0 for a leaf
+} srz_bk_node_t;
+
+typedef struct srz_bk {
+    srz_bk_node_t* nodes;
+    uint32_t count;
+} srz_bk_t;
+
+//A constraint compiled to a bitmask over option indexes
+typedef struct srz_crule {
+    const srz_rule_t* rule;
+    int32_t bit;            //Index of rule->ident, or -1 if the rule has none
+    size_t mask;            //Offset of the rule's mask in masks[]
+} srz_crule_t;
+
+typedef struct srz_schema {
+    srz_opt_t* opts;
+    srz_opt_t* merged;      //opts, when it is a subcommand's table merged with the global one
+    srz_cfg_t cfg;
+    size_t count;
+    uint32_t* lng_off;      //Pool offset of each long name, indexed like opts
+    srz_span_t* enm;        //Each option's run of enum names in enm_off
+    uint32_t* enm_off;      //Pool offsets of all enum names, in map order
+    uint32_t* enm_hash;     //Names of the larger enum maps by hash, built on first use: enm_off index + 1, or 0
+    size_t enm_mask;
+    srz_pool_t names;       //Interned option and enum names
+    int32_t srt_idx[256];   //Index of each short option, or -1
+    srz_trie_t lng;         //Long option names, without dashes
+    srz_bk_t bk;            //Long and enum names by edit distance, for suggestions
+    uint32_t lng_bk;        //Root of the long names in bk
+    uint32_t* enm_bk;       //Root of each option's enum names in bk
+    size_t words;           //Length of each bitset in 64 bit words
+    uint64_t* seen;         //Options given so far
+    srz_crule_t* rules;
+    size_t nrules;
+    uint64_t* masks;        //One bitset per rule
+    srz_limits_t used;      //Spent so far against cfg.limits
+} srz_schema_t;
+
+//Charge n to one of the limits, 0 being none
+static inline srz_errno_t _srz_limit(size_t* used, size_t limit, size_t n, srz_errno_t err)
+{
+    if(!limit){
+        return SRZ_ERR_NONE;
+    }
+    if(n > limit - (*used < limit ? *used : limit)){
+        *used = limit;
+        return err;
+    }
+
+    *used += n;
+    return SRZ_ERR_NONE;
+}
+
+//Whether any limit is set, a limited parse reads no files and answers no completion requests
+static inline bool _srz_limited(const srz_limits_t* limits)
+{
+    return limits->tokens || limits->bytes || limits->elems || limits->memory || limits->fuzzy;
+}
+
+static inline srz_errno_t _srz_limit_mem(srz_schema_t* schema, size_t n)
+{
+    return schema ? _srz_limit(&schema->used.memory, schema->cfg.limits.memory, n, SRZ_ERR_LIMIT_MEMORY) : SRZ_ERR_NONE;
+}
+
+static inline void _srz_schema_free(srz_schema_t* schema)
+{
+    _srz_trie_free(&schema->lng);
+    _srz_pool_free(&schema->names);
+    SRZ_FREE(schema->lng_off);
+    SRZ_FREE(schema->enm);
+    SRZ_FREE(schema->enm_off);
+    SRZ_FREE(schema->enm_hash);
+    SRZ_FREE(schema->merged);
+    SRZ_FREE(schema->seen);
+    SRZ_FREE(schema->rules);
+    SRZ_FREE(schema->masks);
+    SRZ_FREE(schema->bk.nodes);
+    SRZ_FREE(schema->enm_bk);
+    schema->bk.nodes = NULL;
+    schema->enm_bk   = NULL;
+    schema->lng_off = NULL;
+    schema->enm     = NULL;
+    schema->enm_off = NULL;
+    schema->enm_hash = NULL;
+    schema->merged  = NULL;
+    schema->seen    = NULL;
+    schema->rules   = NULL;
+    schema->masks   = NULL;
+}
+
+static inline srz_errno_t _srz_schema_build(srz_schema_t* schema, srz_opt_t* opts, const srz_cfg_t* cfg)
+{
+    const srz_cfg_t cfg_default = SRZ_CFG_DEFAULT;
+
+    memset(schema, 0, sizeof(srz_schema_t));
+    schema->opts = opts;
+    schema->cfg  = cfg ? *cfg : cfg_default;
+
+    memset(schema->srt_idx, 0xFF, sizeof(schema->srt_idx));
+    size_t enm_count = 0;
+    for(srz_opt_t* opt = opts; !opt->fin; opt++){
+        schema->count++;
+        if(_srz_is_enum_type(opt->val.type) && opt->val.enm_map){
+            for(const srz_enum_t* e = opt->val.enm_map; e->str; e++){
+                enm_count++;
+            }
+        }
+    }
+
+    schema->lng_off = SRZ_CALLOC(schema->count + 1, sizeof(uint32_t));
+    schema->enm     = SRZ_CALLOC(schema->count + 1, sizeof(srz_span_t));
+    schema->enm_off = SRZ_CALLOC(enm_count + 1, sizeof(uint32_t));
+    if(!schema->lng_off || !schema->enm || !schema->enm_off){
+        return SRZ_ERR_NOMEM;
+    }
+
+    srz_errno_t err = _srz_trie_init(&schema->lng);
+    enm_count = 0;
+    for(size_t i = 0; i < schema->count && !err; i++){
+        srz_opt_t* opt = opts + i;
+        schema->lng_off[i] = SRZ_POOL_NONE;
+
+        if(!isempty(opt->srt)){
+            schema->srt_idx[(unsigned char)opt->srt[0]] = (int32_t)i;
+        }
+
+        if(_srz_is_enum_type(opt->val.type) && opt->val.enm_map){
+            schema->enm[i].first = (uint32_t)enm_count;
+            for(const srz_enum_t* e = opt->val.enm_map; e->str; e++){
+                const uint32_t off = _srz_pool_add(&schema->names, e->str, strlen(e->str));
+                if(off == SRZ_POOL_NONE){
+                    return SRZ_ERR_NOMEM;
+                }
+                schema->enm_off[enm_count++] = off;
+            }
+            schema->enm[i].count = (uint32_t)enm_count - schema->enm[i].first;
+        }
+
+        if(isempty(opt->lng)){
+            continue;
+        }
+
+        const uint32_t off = _srz_pool_add(&schema->names, opt->lng, strlen(opt->lng));
+        if(off == SRZ_POOL_NONE){
+            return SRZ_ERR_NOMEM;
+        }
+        schema->lng_off[i] = off;
+
+        const srz_slice_t lng = _srz_pool_get(&schema->names, off);
+
+        bool dup = false;
+        err = _srz_trie_insert(&schema->lng, lng.str, lng.len, opt, &dup);
+        if(dup){
+            SRZ_FAIL("%s `%s`\n", srz_err2str_en(SRZ_ERR_LOPT_DUP), lng.str);
+            return SRZ_ERR_LOPT_DUP;
+        }
+    }
+
+    return err;
+}
+
+static inline srz_slice_t _srz_lng_name(const srz_schema_t* schema, size_t idx)
+{
+    return _srz_pool_get(&schema->names, schema->lng_off[idx]);
+}
+
+//Find name among the enum values of option idx. Returns the index into its map, or -1.
+//FNV-1a of the name, seeded with the option so equal names in different maps spread apart
+static inline size_t _srz_enum_hash(size_t idx, srz_slice_t name)
+{
+    uint64_t h = UINT64_C(0xcbf29ce484222325) ^ ((uint64_t)idx * UINT64_C(0x9E3779B97F4A7C15));
+    for(size_t i = 0; i < name.len; i++){
+        h = (h ^ (unsigned char)name.str[i]) * UINT64_C(0x100000001b3);
+    }
+    return (size_t)(h ^ (h >> 32));
+}
+
+static inline srz_errno_t _srz_enum_hash_build(srz_schema_t* schema)
+{
+    if(schema->enm_hash){
+        return SRZ_ERR_NONE;
+    }
+
+    size_t total = 0;
+    for(size_t i = 0; i < schema->count; i++){
+        total += schema->enm[i].count >= SRZ_ENUM_HASH_MIN ? schema->enm[i].count : 0;
+    }
+    size_t size = 64;
+    while(size < total * 2){
+        size *= 2;
+    }
+
+    schema->enm_hash = SRZ_CALLOC(size, sizeof(uint32_t));
+    if(!schema->enm_hash){
+        return SRZ_ERR_NOMEM;
+    }
+    schema->enm_mask = size - 1;
+
+    for(size_t i = 0; i < schema->count; i++){
+        const srz_span_t span = schema->enm[i];
+        for(uint32_t k = 0; span.count >= SRZ_ENUM_HASH_MIN && k < span.count; k++){
+            const srz_slice_t name = _srz_pool_get(&schema->names, schema->enm_off[span.first + k]);
+            size_t h = _srz_enum_hash(i, name) & schema->enm_mask;
+            while(schema->enm_hash[h]){
+                h = (h + 1) & schema->enm_mask;
+            }
+            schema->enm_hash[h] = span.first + k + 1;
+        }
+    }
+
+    return SRZ_ERR_NONE;
+}
+
+static inline int _srz_find_enum(const srz_schema_t* schema, size_t idx, srz_slice_t name)
+{
+    const srz_span_t span = schema->enm[idx];
+    if(span.count >= SRZ_ENUM_HASH_MIN && !_srz_enum_hash_build((srz_schema_t*)schema)){
+        for(size_t h = _srz_enum_hash(idx, name) & schema->enm_mask; schema->enm_hash[h]; h = (h + 1) & schema->enm_mask){
+            const uint32_t at = schema->enm_hash[h] - 1;
+            if(at - span.first < span.count && _srz_slice_eq(_srz_pool_get(&schema->names, schema->enm_off[at]), name)){
+                return (int)(at - span.first);
+            }
+        }
+        return -1;
+    }
+
+    for(uint32_t k = 0; k < span.count; k++){
+        if(_srz_slice_eq(_srz_pool_get(&schema->names, schema->enm_off[span.first + k]), name)){
+            return (int)k;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Constraints
+ * ===========================================================================
+ * Each rule becomes a bitmask over option indexes when the schema is compiled,
+ * and the parser sets a bit in seen[] for every option given. Checking a rule
+ * is then a few word-wide operations per 64 options, whatever its size.
+ */
+
+typedef struct srz_ident_idx {
+    int ident;
+    int32_t idx;
+} srz_ident_idx_t;
+
+static int _srz_ident_cmp(const void* a, const void* b)
+{
+    const int x = ((const srz_ident_idx_t*)a)->ident;
+    const int y = ((const srz_ident_idx_t*)b)->ident;
+    return (x > y) - (x < y);
+}
+
+static inline void _srz_bit_set(uint64_t* bits, size_t i)
+{
+    bits[i / 64] |= UINT64_C(1) << (i % 64);
+}
+
+static inline bool _srz_bit_get(const uint64_t* bits, size_t i)
+{
+    return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+//Set the bits of every option with this ident. False if there are none.
+static inline bool _srz_rule_ident(const srz_ident_idx_t* map, size_t count, int ident, uint64_t* mask, int32_t* first)
+{
+    const srz_ident_idx_t key = { .ident = ident, .idx = 0 };
+    const srz_ident_idx_t* hit = bsearch(&key, map, count, sizeof(srz_ident_idx_t), _srz_ident_cmp);
+    if(!hit){
+        return false;
+    }
+
+    while(hit > map && hit[-1].ident == ident){
+        hit--;
+    }
+    if(first){
+        *first = hit->idx;
+    }
+    for(; hit < map + count && hit->ident == ident; hit++){
+        if(mask){
+            _srz_bit_set(mask, (size_t)hit->idx);
+        }
+    }
+
+    return true;
+}
+
+static inline srz_errno_t _srz_rules_build(srz_schema_t* schema)
+{
+    schema->words = (schema->count + 63) / 64;
+    schema->seen  = SRZ_CALLOC(schema->words + 1, sizeof(uint64_t));
+    if(!schema->seen){
+        return SRZ_ERR_NOMEM;
+    }
+
+    const srz_rule_t* rules = schema->cfg.rules;
+    size_t nrules = 0;
+    for(const srz_rule_t* r = rules; r && !r->fin; r++){
+        nrules++;
+    }
+    if(!nrules){
+        return SRZ_ERR_NONE;
+    }
+
+    srz_ident_idx_t* map = SRZ_CALLOC(schema->count + 1, sizeof(srz_ident_idx_t));
+    schema->rules = SRZ_CALLOC(nrules, sizeof(srz_crule_t));
+    schema->masks = SRZ_CALLOC(nrules * schema->words + 1, sizeof(uint64_t));
+    if(!map || !schema->rules || !schema->masks){
+        SRZ_FREE(map);
+        return SRZ_ERR_NOMEM;
+    }
+
+    for(size_t i = 0; i < schema->count; i++){
+        map[i].ident = schema->opts[i].ident;
+        map[i].idx   = (int32_t)i;
+    }
+    qsort(map, schema->count, sizeof(srz_ident_idx_t), _srz_ident_cmp);
+
+    srz_errno_t err = SRZ_ERR_NONE;
+    for(const srz_rule_t* r = rules; !r->fin && !err; r++){
+        srz_crule_t* crule = schema->rules + schema->nrules;
+        crule->rule = r;
+        crule->bit  = -1;
+        crule->mask = schema->nrules * schema->words;
+        uint64_t* mask = schema->masks + crule->mask;
+
+        bool found = true;
+        if(r->type == SRZ_RULE_REQUIRES || r->type == SRZ_RULE_CONFLICTS){
+            found = _srz_rule_ident(map, schema->count, r->ident, NULL, &crule->bit);
+        }
+        for(size_t k = 0; k < r->count && found; k++){
+            found = _srz_rule_ident(map, schema->count, r->idents[k], mask, NULL);
+        }
+
+        if(found){
+            schema->nrules++;
+        }
+        else if(!schema->cfg.cmds){
+            SRZ_FAIL("%s.\n", srz_err2str_en(SRZ_ERR_RULE_IDENT));
+            err = SRZ_ERR_RULE_IDENT;
+        }
+        else{
+            memset(mask, 0, schema->words * sizeof(uint64_t));
+        }
+    }
+
+    SRZ_FREE(map);
+    return err;
+}
+
+static inline const char* _srz_opt_name(const srz_opt_t* opt)
+{
+    return isempty(opt->lng) ? opt->srt : opt->lng;
+}
+
+//Name every option in bits, for the violation message
+SRZ_COLD static inline void _srz_rule_names(const srz_schema_t* schema, const uint64_t* bits, char* out, size_t size)
+{
+    size_t len = 0;
+    out[0] = '\0';
+    for(size_t i = 0; i < schema->count && len < size; i++){
+        if(_srz_bit_get(bits, i)){
+            const int n = snprintf(out + len, size - len, "%s`%s`", len ? ", " : "", _srz_opt_name(schema->opts + i));
+            len += n > 0 ? (size_t)n : 0;
+        }
+    }
+}
+
+//Source jobs run this on threads of their own, without rules, so only a broken rule may write the globals.
+//The parse resets srz_violation() where it resets srz_command(), on the calling thread.
+static inline srz_errno_t _srz_rules_check(const srz_schema_t* schema)
+{
+    const uint64_t* seen = schema->seen;
+    const size_t words = schema->words;
+    srz_errno_t err = SRZ_ERR_NONE;
+
+    for(size_t r = 0; r < schema->nrules; r++){
+        const srz_crule_t* crule = schema->rules + r;
+        const uint64_t* mask = schema->masks + crule->mask;
+        const srz_rule_type_t type = crule->rule->type;
+
+        if(crule->bit >= 0 && !_srz_bit_get(seen, (size_t)crule->bit)){
+            continue; //Only applies if its option was given
+        }
+
+        uint64_t any = 0;
+        size_t given = 0;
+        for(size_t w = 0; w < words; w++){
+            switch(type){
+                case SRZ_RULE_REQUIRED:
+                case SRZ_RULE_REQUIRES:  any |= mask[w] & ~seen[w]; break;
+                case SRZ_RULE_CONFLICTS: any |= mask[w] & seen[w];  break;
+                case SRZ_RULE_ONE_OF:    given += (size_t)_srz_popcount64(mask[w] & seen[w]); break;
+            }
+        }
+        if(type == SRZ_RULE_ONE_OF ? given == 1 : !any){
+            continue;
+        }
+
+        //Broken, so the slow path can afford to work out which options to name
+        char names[256] = "";
+        uint64_t* bad = SRZ_CALLOC(words + 1, sizeof(uint64_t));
+        if(bad){
+            for(size_t w = 0; w < words; w++){
+                bad[w] = type == SRZ_RULE_CONFLICTS ? mask[w] & seen[w] :
+                         type == SRZ_RULE_ONE_OF    ? mask[w] : mask[w] & ~seen[w];
+            }
+            _srz_rule_names(schema, bad, names, sizeof(names));
+            SRZ_FREE(bad);
+        }
+        const char* opt = crule->bit >= 0 ? _srz_opt_name(schema->opts + crule->bit) : "";
+        switch(type){
+            case SRZ_RULE_REQUIRED:  SRZ_WARN("Missing required option %s\n", names); break;
+            case SRZ_RULE_REQUIRES:  SRZ_WARN("`%s` requires %s\n", opt, names); break;
+            case SRZ_RULE_CONFLICTS: SRZ_WARN("`%s` conflicts with %s\n", opt, names); break;
+            case SRZ_RULE_ONE_OF:    SRZ_WARN("Exactly one of %s is required\n", names); break;
+        }
+
+        if(!err){
+            ___srz___.violation = crule->rule;
+            err = SRZ_ERR_CONSTRAINT;
+        }
+    }
+
+    return err;
+}
+
+static inline srz_opt_t* _srz_find_short(const srz_schema_t* schema, char s)
+{
+    const int32_t idx = schema->srt_idx[(unsigned char)s];
+    return idx < 0 ? NULL : schema->opts + idx;
+}
+
+static inline srz_opt_t* _srz_find_long(const srz_schema_t* schema, srz_slice_t l)
+{
+    size_t rest = 0;
+    const int32_t node = _srz_trie_find(&schema->lng, l.str, l.len, &rest);
+    if(node < 0 || rest || !schema->lng.nodes[node].term){
+        return NULL;
+    }
+
+    return (srz_opt_t*)schema->lng.nodes[node].opt;
+}
+
+//Resolve an abbreviated long option. Returns the option if the prefix is unique.
+//Otherwise the options the prefix could mean are put in cands.
+static inline srz_opt_t* _srz_find_long_prefix(const srz_schema_t* schema, srz_slice_t l, srz_cands_t* cands)
+{
+    const srz_trie_t* trie = &schema->lng;
+    int32_t node = _srz_trie_find(trie, l.str, l.len, NULL);
+    cands->count = 0;
+    if(node <= 0){
+        return NULL;
+    }
+
+    if(trie->nodes[node].words > 1){
+        cands->count = _srz_trie_collect(trie, node, cands->opts, 0, SRZ_CANDS_MAX);
+        for(size_t i = 0; i < cands->count; i++){
+            cands->names[i] = cands->opts[i]->lng;
+            cands->dist[i]  = 0;
+        }
+        return NULL;
+    }
+
+    while(!trie->nodes[node].term){
+        node = trie->nodes[node].child;
+    }
+
+    return (srz_opt_t*)trie->nodes[node].opt;
+}
+
+//The trie node holding every long name under the dotted scope path, or -1. The path
+//must end where a '.' follows it: inside a label, whose node then only has names with
+//that '.' below it, or at a node, whose '.' child is taken. Either way the subtree is
+//exactly the scope.
+static inline int32_t _srz_find_scope(const srz_schema_t* schema, srz_slice_t path)
+{
+    const srz_trie_t* trie = &schema->lng;
+    size_t rest = 0;
+    int32_t node = _srz_trie_find(trie, path.str, path.len, &rest);
+    if(node < 0 || !path.len){
+        return node;
+    }
+
+    if(rest){
+        const srz_trie_node_t* n = trie->nodes + node;
+        return _srz_trie_label(trie, node)[n->len - rest] == '.' ? node : -1;
+    }
+
+    return _srz_trie_child(trie, node, '.');
+}
+
+#if SRZ_FUZZY_MAX_LEN > 64
+#error "SRZ_FUZZY_MAX_LEN must be at most 64, a pattern is held in one 64 bit word"
+#endif
+
+//A pattern for _srz_edit_distance(). Bit i of eq[c] is set where character i is c.
+typedef struct srz_peq {
+    uint64_t eq[256];
+    uint64_t last;  //Bit of the last character
+    size_t len;
+} srz_peq_t;
+
+static inline void _srz_peq(srz_peq_t* peq, srz_slice_t pat)
+{
+    memset(peq->eq, 0, sizeof(peq->eq));
+    for(size_t i = 0; i < pat.len; i++){
+        peq->eq[(unsigned char)pat.str[i]] |= UINT64_C(1) << i;
+    }
+    peq->len  = pat.len;
+    peq->last = pat.len ? UINT64_C(1) << (pat.len - 1) : 0;
+}
+
+//Edit distance from the pattern to s, or bound + 1 as soon as it is certain to exceed bound.
+//Bit-parallel (Myers, in Hyyro's form for edit distance): a whole column of the table is
+//updated with a handful of word operations, so each character of s costs O(1).
+SRZ_COLD static inline size_t _srz_edit_distance(const srz_peq_t* peq, srz_slice_t s, size_t bound)
+{
+    if(peq->len == 0){
+        return s.len <= bound ? s.len : bound + 1;
+    }
+
+    uint64_t pv = ~UINT64_C(0); //Vertical deltas of +1
+    uint64_t mv = 0;            //Vertical deltas of -1
+    size_t score = peq->len;
+
+    for(size_t j = 0; j < s.len; j++){
+        const uint64_t eq = peq->eq[(unsigned char)s.str[j]];
+        const uint64_t xv = eq | mv;
+        const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        //Branch free, the sign of each step is as good as random
+        score += (size_t)((ph & peq->last) != 0) - (size_t)((mh & peq->last) != 0);
+
+        //Each character left can take at most one off the distance
+        if(score > bound + (s.len - j - 1)){
+            return bound + 1;
+        }
+
+        ph = (ph << 1) | 1; //The first row of the table counts up
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+
+    return score <= bound ? score : bound + 1;
+}
+
+/*
+ * Suggestions
+ * ===========================================================================
+ * Long option names, and the enum names of each option, are indexed in BK-trees
+ * when the schema is compiled. Each child sits at a known edit distance from its
+ * parent, so by the triangle inequality a search within r of a token found to be
+ * d away from a node only descends into the children between d - r and d + r away.
+ * Most parses never need a suggestion, so the trees are built the first time one does.
+ */
+
+static inline size_t _srz_sig_bound(uint64_t a, uint64_t b)
+{
+    const int a_only = _srz_popcount64(a & ~b);
+    const int b_only = _srz_popcount64(b & ~a);
+    return a_only > b_only ? a_only : b_only;
+}
+
+static inline srz_slice_t _srz_bk_name(const srz_schema_t* schema, uint32_t node)
+{
+    return _srz_pool_get(&schema->names, schema->bk.nodes[node].off);
+}
+
+//Index the interned name at off under the tree at *root. Names too long to ever be suggested are left out.
+SRZ_COLD static inline void _srz_bk_insert(srz_schema_t* schema, srz_peq_t* peq, uint32_t* root, uint32_t off, uint32_t idx)
+{
+    srz_bk_t* bk = &schema->bk;
+    const srz_slice_t name = _srz_pool_get(&schema->names, off);
+    if(name.len == 0 || name.len > SRZ_FUZZY_MAX_LEN){
+        return;
+    }
+    _srz_peq(peq, name);
+
+    //Follow the child at the same distance as the new name down until there is none
+    uint32_t* link = root;
+    uint32_t dist = 0;
+    while(*link != _SRZ_BK_NONE){
+        const uint32_t node = *link;
+        dist = (uint32_t)_srz_edit_distance(peq, _srz_bk_name(schema, node), SRZ_FUZZY_MAX_LEN);
+        if(dist == 0){
+            return; //A duplicate enum name, the first one is suggested
+        }
+
+        if(bk->nodes[node].reach < dist){
+            bk->nodes[node].reach = (uint16_t)dist;
+        }
+        link = &bk->nodes[node].child;
+        while(*link != _SRZ_BK_NONE && bk->nodes[*link].dist != dist){
+            link = &bk->nodes[*link].sibling;
+        }
+    }
+
+    //The nodes array is sized for every name up front, so link stays valid
+    const uint32_t node = bk->count++;
+    bk->nodes[node] = (srz_bk_node_t){
+        .sig     = _srz_sig(name.str, name.len),
+        .off     = off,
+        .idx     = idx,
+        .child   = _SRZ_BK_NONE,
+        .sibling = _SRZ_BK_NONE,
+        .dist    = (uint16_t)dist,
+        .reach   = 0,
+    };
+    *link = node;
+}
+
+SRZ_COLD static inline srz_errno_t _srz_bk_build(srz_schema_t* schema)
+{
+    if(schema->bk.nodes){
+        return SRZ_ERR_NONE;
+    }
+
+    size_t total = schema->count;
+    for(size_t i = 0; i < schema->count; i++){
+        total += schema->enm[i].count;
+    }
+
+    schema->enm_bk   = SRZ_MALLOC((schema->count + 1) * sizeof(uint32_t));
+    schema->bk.nodes = schema->enm_bk ? SRZ_MALLOC((total + 1) * sizeof(srz_bk_node_t)) : NULL;
+    if(!schema->bk.nodes){
+        SRZ_WARN("%s, no suggestions\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        SRZ_FREE(schema->enm_bk);
+        schema->enm_bk = NULL;
+        return SRZ_ERR_NOMEM;
+    }
+
+    srz_peq_t peq;
+    schema->lng_bk = _SRZ_BK_NONE;
+    for(size_t i = 0; i < schema->count; i++){
+        if(schema->lng_off[i] != SRZ_POOL_NONE){
+            _srz_bk_insert(schema, &peq, &schema->lng_bk, schema->lng_off[i], (uint32_t)i);
+        }
+
+        const srz_span_t span = schema->enm[i];
+        schema->enm_bk[i] = _SRZ_BK_NONE;
+        for(uint32_t k = 0; k < span.count; k++){
+            _srz_bk_insert(schema, &peq, &schema->enm_bk[i], schema->enm_off[span.first + k], k);
+        }
+    }
+
+    return SRZ_ERR_NONE;
+}
+
+typedef struct srz_hit {
+    size_t dist;
+    uint32_t idx;   //Option index, or index into the option's enum map
+    bool srt;       //The short name matched
+} srz_hit_t;
+
+//The best k names found so far, closest first
+typedef struct srz_hits {
+    srz_hit_t hit[SRZ_CANDS_MAX];
+    size_t count;
+    size_t k;
+    size_t max_dist;    //Search radius, which closes in to the k-th best once there are k
+    size_t budget;      //Name characters left to compare
+    size_t start;       //Budget the search started with, to charge what it used to the fuzzy limit
+} srz_hits_t;
+
+static inline srz_hits_t _srz_hits(size_t k, size_t max_dist)
+{
+    srz_hits_t hits = { .count = 0, .k = k < SRZ_CANDS_MAX ? k : SRZ_CANDS_MAX, .max_dist = max_dist, .budget = SRZ_FUZZY_BUDGET };
+    return hits;
+}
+
+//Cap a search at what is left of the parse's fuzzy limit
+static inline void _srz_fuzzy_budget(const srz_schema_t* schema, srz_hits_t* hits)
+{
+    const size_t limit = schema->cfg.limits.fuzzy;
+    if(limit && limit - schema->used.fuzzy < hits->budget){
+        hits->budget = limit - schema->used.fuzzy;
+    }
+    hits->start = hits->budget;
+    SRZ_PROBE(fuzzy__start, hits->budget);
+}
+
+//Charge a finished search to the fuzzy limit
+static inline void _srz_fuzzy_spent(srz_schema_t* schema, const srz_hits_t* hits)
+{
+    schema->used.fuzzy += hits->start - hits->budget;
+    SRZ_PROBE(fuzzy__end, hits->start - hits->budget, hits->count);
+}
+
+//Closer first, then in table order, then long names before short ones
+static inline bool _srz_hit_before(srz_hit_t a, srz_hit_t b)
+{
+    if(a.dist != b.dist){
+        return a.dist < b.dist;
+    }
+    if(a.idx != b.idx){
+        return a.idx < b.idx;
+    }
+    return !a.srt && b.srt;
+}
+
+static inline void _srz_hits_add(srz_hits_t* hits, srz_hit_t hit)
+{
+    size_t at = hits->count;
+    if(at == hits->k){
+        if(!hits->k || !_srz_hit_before(hit, hits->hit[at - 1])){
+            return;
+        }
+        at--;
+    }
+    else{
+        hits->count++;
+    }
+
+    for(; at > 0 && _srz_hit_before(hit, hits->hit[at - 1]); at--){
+        hits->hit[at] = hits->hit[at - 1];
+    }
+    hits->hit[at] = hit;
+
+    if(hits->count == hits->k){
+        hits->max_dist = hits->hit[hits->k - 1].dist;
+    }
+}
+
+SRZ_COLD static inline void _srz_bk_search(const srz_schema_t* schema, uint32_t node, const srz_peq_t* tok, uint64_t tok_sig, srz_hits_t* hits)
+{
+    const srz_bk_node_t* n = schema->bk.nodes + node;
+    const srz_slice_t name = _srz_bk_name(schema, node);
+    const size_t longest = name.len > tok->len ? name.len : tok->len;
+
+    //Neither the node nor a child can be in range once the distance is past the radius plus
+    //the reach of the children. The length and signature bounds may rule that out unread.
+    const size_t bound = hits->max_dist + n->reach;
+    const size_t gap = longest - (name.len > tok->len ? tok->len : name.len);
+    if(gap > bound || _srz_sig_bound(n->sig, tok_sig) > bound){
+        return;
+    }
+
+    if(name.len > hits->budget){
+        hits->budget = 0;
+        return;
+    }
+    hits->budget -= name.len;
+
+    //A match that rewrites every character is no match at all
+    const size_t dist = _srz_edit_distance(tok, name, bound);
+    if(dist > bound){
+        return;
+    }
+    if(dist <= hits->max_dist && dist < longest){
+        _srz_hits_add(hits, (srz_hit_t){ .dist = dist, .idx = n->idx, .srt = false });
+    }
+
+    for(uint32_t child = n->child; child != _SRZ_BK_NONE && hits->budget; child = schema->bk.nodes[child].sibling){
+        const size_t edge = schema->bk.nodes[child].dist;
+        if(edge + hits->max_dist >= dist && edge <= dist + hits->max_dist){
+            _srz_bk_search(schema, child, tok, tok_sig, hits);
+        }
+    }
+}
+
+//Rank the short and long option names closest to tok. The index is a cache, so it is built through a const schema.
+SRZ_COLD static inline void _srz_suggest_opts(const srz_schema_t* schema, srz_slice_t tok, srz_hits_t* hits)
+{
+    if(tok.len == 0 || tok.len > SRZ_FUZZY_MAX_LEN || !hits->budget || _srz_bk_build((srz_schema_t*)schema)){
+        return;
+    }
+
+    //A short name is one edit from any token of two characters that holds it, and no closer
+    for(size_t i = 0; i < tok.len && tok.len - 1 <= hits->max_dist; i++){
+        const int32_t idx = schema->srt_idx[(unsigned char)tok.str[i]];
+        if(idx >= 0 && !memchr(tok.str, tok.str[i], i)){
+            _srz_hits_add(hits, (srz_hit_t){ .dist = tok.len - 1, .idx = (uint32_t)idx, .srt = true });
+        }
+    }
+
+    if(schema->lng_bk != _SRZ_BK_NONE){
+        srz_peq_t peq;
+        _srz_peq(&peq, tok);
+        _srz_bk_search(schema, schema->lng_bk, &peq, _srz_sig(tok.str, tok.len), hits);
+    }
+}
+
+//Rank the enum names of option idx closest to tok
+SRZ_COLD static inline void _srz_suggest_enum(const srz_schema_t* schema, size_t idx, srz_slice_t tok, srz_hits_t* hits)
+{
+    if(tok.len == 0 || tok.len > SRZ_FUZZY_MAX_LEN || !hits->budget || _srz_bk_build((srz_schema_t*)schema) || schema->enm_bk[idx] == _SRZ_BK_NONE){
+        return;
+    }
+
+    srz_peq_t peq;
+    _srz_peq(&peq, tok);
+    _srz_bk_search(schema, schema->enm_bk[idx], &peq, _srz_sig(tok.str, tok.len), hits);
+}
+
+//Copy hits out as candidates. With an enum option the names are its enum names, otherwise option names.
+static inline void _srz_hits_cands(const srz_schema_t* schema, const srz_opt_t* enm, const srz_hits_t* hits, srz_cands_t* cands)
+{
+    cands->count = hits->count;
+    for(size_t i = 0; i < hits->count; i++){
+        const srz_hit_t hit = hits->hit[i];
+        const srz_opt_t* opt = enm ? enm : schema->opts + hit.idx;
+        cands->opts[i]  = opt;
+        cands->names[i] = enm ? enm->val.enm_map[hit.idx].str : hit.srt ? opt->srt : opt->lng;
+        cands->dist[i]  = hit.dist;
+    }
+}
+
+static inline void _srz_cands_one(srz_cands_t* cands, const srz_opt_t* opt, bool srt)
+{
+    cands->count    = 1;
+    cands->opts[0]  = opt;
+    cands->names[0] = srt ? opt->srt : opt->lng;
+    cands->dist[0]  = 0;
+}
+
+//Index of opt in the schema being parsed, or SIZE_MAX if it is not one of its options
+static inline size_t _srz_schema_idx(const srz_schema_t* schema, const srz_opt_t* opt)
+{
+    if(schema && opt && (uintptr_t)opt >= (uintptr_t)schema->opts && (uintptr_t)opt < (uintptr_t)(schema->opts + schema->count)){
+        return (size_t)(opt - schema->opts);
+    }
+
+    return SIZE_MAX;
+}
+
+size_t srz_scope_opts(const char* path, const srz_opt_t** out, size_t max)
+{
+    const srz_schema_t* schema = ___srz___.schema;
+    if(!schema || !path){
+        return 0;
+    }
+
+    const int32_t node = _srz_find_scope(schema, _srz_slice(path, strlen(path)));
+    if(node < 0){
+        return 0;
+    }
+
+    _srz_trie_collect(&schema->lng, node, out, 0, max);
+    return schema->lng.nodes[node].words;
+}
+
+SRZ_COLD size_t srz_suggest(const srz_opt_t* opt, const char* tok, size_t max_dist, size_t k, srz_cands_t* cands)
+{
+    const srz_schema_t* schema = ___srz___.schema;
+    const size_t idx = _srz_schema_idx(schema, opt);
+    srz_hits_t hits = _srz_hits(k, max_dist);
+
+    cands->count = 0;
+    if(!schema || !tok || (opt && idx == SIZE_MAX)){
+        return 0;
+    }
+
+    if(opt){
+        _srz_suggest_enum(schema, idx, _srz_slice(tok, strlen(tok)), &hits);
+    }
+    else{
+        _srz_suggest_opts(schema, _srz_slice(tok, strlen(tok)), &hits);
+    }
+
+    _srz_hits_cands(schema, opt, &hits, cands);
+    return cands->count;
+}
+
+#if SRZ_PARALLEL
+static _Thread_local bool _srz_in_chunk; //Converting a chunk of a parallel value, where the fuzzy limit cannot be charged
+#endif
+
+//The closest enum name to a bad value of opt, for the warning, or NULL
+SRZ_COLD static inline const char* _srz_enum_hint(const srz_opt_t* opt, srz_slice_t s)
+{
+    const srz_schema_t* schema = ___srz___.schema;
+#if SRZ_PARALLEL
+    //The chunks of one value run at once and would race on schema->used, so they give no hints
+    if(_srz_in_chunk){
+        return NULL;
+    }
+#endif
+    const size_t idx = _srz_schema_idx(schema, opt);
+    if(idx == SIZE_MAX){
+        return NULL;
+    }
+
+    srz_hits_t hits = _srz_hits(SRZ_CANDS_MAX, SRZ_FUZZY_MAX_DIST);
+    _srz_fuzzy_budget(schema, &hits);
+    _srz_suggest_enum(schema, idx, s, &hits);
+    _srz_fuzzy_spent((srz_schema_t*)schema, &hits);
+    return hits.count ? opt->val.enm_map[hits.hit[0].idx].str : NULL;
+}
+
+
+//Fuzzy search to try and find the best match for an option, the ranked candidates are put in cands
+//The token is stripped of leading dashes and any "=value" suffix before matching. Tokens
+//longer than SRZ_FUZZY_MAX_LEN are never matched, and no more than SRZ_FUZZY_BUDGET name
+//characters are compared, so the cost of a garbage token is bounded.
+static inline srz_opt_t* _srz_fuzzy_find_opt(const srz_schema_t* schema, const char* s, srz_opt_type_t* opt_type_o, srz_cands_t* cands)
+{
+    *opt_type_o = SRZ_OPT_NONE;
+    cands->count = 0;
+
+    //Trivial escape
+    if(isempty(s)){
+        //We're never going to match anything
+        return NULL;
+    }
+
+    const char* tok = s;
+    if(tok[0] == '-'){
+        tok++;
+        if(tok[0] == '-'){
+            tok++;
+        }
+    }
+
+    size_t tok_len = 0;
+    while(tok[tok_len] && tok[tok_len] != '='){
+        if(++tok_len > SRZ_FUZZY_MAX_LEN){
+            //Too long to be a useful suggestion, don't even finish the strlen()
+            return NULL;
+        }
+    }
+
+    if(tok_len == 0){
+        return NULL;
+    }
+
+    //Try an exact match for the short string
+    srz_opt_t* result = NULL;
+    if(tok_len == 1){
+        result = _srz_find_short(schema,tok[0]);
+        if(result){
+            *opt_type_o = SRZ_OPT_SHORT;
+            _srz_cands_one(cands, result, true);
+            return result;
+        }
+    }
+
+    //Try an exact match for the long string
+    const srz_slice_t tok_s = _srz_slice(tok, tok_len);
+    result = _srz_find_long(schema, tok_s);
+    if(result){
+        *opt_type_o = SRZ_OPT_LONG;
+        _srz_cands_one(cands, result, false);
+        return result;
+    }
+
+    //We've tried hard to find an exact match, now try fuzzy matching
+    srz_hits_t hits = _srz_hits(SRZ_CANDS_MAX, SRZ_FUZZY_MAX_DIST);
+    _srz_fuzzy_budget(schema, &hits);
+    _srz_suggest_opts(schema, tok_s, &hits);
+    _srz_fuzzy_spent((srz_schema_t*)schema, &hits);
+    _srz_hits_cands(schema, NULL, &hits, cands);
+    if(!hits.count){
+        return NULL;
+    }
+
+    *opt_type_o = hits.hit[0].srt ? SRZ_OPT_SHORT : SRZ_OPT_LONG;
+    return schema->opts + hits.hit[0].idx;
+}
+
+//Suggest for a single character of a short option cluster, the rest of the cluster says nothing about it
+static inline srz_opt_t* _srz_fuzzy_find_char(const srz_schema_t* schema, char c, srz_opt_type_t* opt_type_o, srz_cands_t* cands)
+{
+    const char tok[3] = { '-', c, '\0' };
+    return _srz_fuzzy_find_opt(schema, tok, opt_type_o, cands);
+}
+
+static inline int _srz_positional_count(srz_opt_t opts[])
+{
+    int result = 0;
+    for(srz_opt_t* opt = opts; !opt->fin; opt++){
+
+        if(opt->atype == SRZ_ARG_POS){
+            result++;
+        }
+    }
+
+    return result;
+}
+
+static inline srz_opt_t* _srz_get_positional(srz_opt_t opts[])
+{
+    for(srz_opt_t* opt = opts; !opt->fin; opt++){
+
+        if(opt->atype == SRZ_ARG_POS){
+            return opt;
+        }
+    }
+
+    return NULL;
+}
+
+static inline int _srz_no_short_long(srz_opt_t opts[])
+{
+    for(srz_opt_t* opt = opts; !opt->fin; opt++){
+        if(opt->atype != SRZ_ARG_POS){
+            if(isempty(opt->srt) && isempty(opt->lng)){
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+//Short names must be one character, unique, and neither '-' nor ':'
+static inline srz_errno_t _srz_check_short_opts(const srz_opt_t opts[])
+{
+    bool seen[256] = { 0 };
+    seen['-'] = seen[':'] = true;
+
+    for(const srz_opt_t* opt = opts; !opt->fin; opt++){
         const char* srt = opt->srt;
         if(isempty(srt)){
             continue;
         }
 
-        if(strlen(srt) > 1){
-            SRZ_FAIL("%s (`%s`)\n", srz_err2str_en(SRZ_ERR_SOPT_TOO_LONG), srt);
-            return SRZ_ERR_SOPT_TOO_LONG;
+        if(srt[1] != '\0'){
+            SRZ_FAIL("%s (`%s`)\n", srz_err2str_en(SRZ_ERR_SOPT_TOO_LONG), srt);
+            return SRZ_ERR_SOPT_TOO_LONG;
+        }
+
+        if(seen[(unsigned char)srt[0]]){
+            SRZ_FAIL("%s `%c`\n", srz_err2str_en(SRZ_ERR_SOPT_DUP), srt[0]);
+            return SRZ_ERR_SOPT_DUP;
+        }
+        seen[(unsigned char)srt[0]] = true;
+    }
+
+    return SRZ_ERR_NONE;
+}
+
+//Check an options table and build everything the parser needs from it
+static inline srz_errno_t _srz_compile(srz_schema_t* schema, srz_opt_t* opts, const srz_cfg_t* cfg)
+{
+    srz_errno_t err = SRZ_ERR_NONE;
+    memset(schema, 0, sizeof(srz_schema_t));
+
+    if(_srz_no_short_long(opts)){
+        SRZ_FAIL("%s.\n", srz_err2str_en(SRZ_ERR_NO_SHORT_LONG));
+        return SRZ_ERR_NO_SHORT_LONG;
+    }
+
+    if(_srz_positional_count(opts) > 1){
+        SRZ_FAIL("%s.\n", srz_err2str_en(SRZ_ERR_MULTI_POSITIONAL));
+        return SRZ_ERR_MULTI_POSITIONAL;
+    }
+
+    err = _srz_check_short_opts(opts);
+    if(err){
+        return err;
+    }
+
+    err = _srz_schema_build(schema, opts, cfg);
+    if(err){
+        SRZ_FAIL("Could not build long options trie\n");
+        return err;
+    }
+
+    err = _srz_rules_build(schema);
+    if(err){
+        SRZ_FAIL("Could not compile constraints\n");
+        return err;
+    }
+
+    return err;
+}
+
+static inline const srz_cmd_t* _srz_find_cmd(const srz_cmd_t* cmds, const char* name)
+{
+    for(const srz_cmd_t* cmd = cmds; cmd && cmd->name; cmd++){
+        if(strcmp(cmd->name, name) == 0){
+            return cmd;
+        }
+    }
+
+    return NULL;
+}
+
+//Register the selected subcommand's options and switch the parser over to them
+//The subcommand's table followed by every global option it does not shadow. remap[i]
+//is the index of global option i in the result, or -1.
+static inline srz_opt_t* _srz_cmd_merge(const srz_schema_t* schema, const srz_opt_t* cmd_opts, int32_t* remap)
+{
+    size_t ncmd = 0;
+    for(size_t i = 0; i < schema->count; i++){
+        remap[i] = 0;
+    }
+    for(const srz_opt_t* opt = cmd_opts; !opt->fin; opt++, ncmd++){
+        int32_t idx = -1;
+        if(!isempty(opt->lng)){
+            const srz_opt_t* g = _srz_find_long(schema, _srz_slice(opt->lng, strlen(opt->lng)));
+            idx = g ? (int32_t)(g - schema->opts) : -1;
+        }
+        if(idx >= 0){
+            remap[idx] = -1;
+        }
+        if(!isempty(opt->srt) && schema->srt_idx[(unsigned char)opt->srt[0]] >= 0){
+            remap[schema->srt_idx[(unsigned char)opt->srt[0]]] = -1;
+        }
+        if(opt->atype == SRZ_ARG_POS){
+            const srz_opt_t* pos = _srz_get_positional(schema->opts);
+            if(pos){
+                remap[pos - schema->opts] = -1;
+            }
+        }
+    }
+
+    srz_opt_t* merged = SRZ_MALLOC((ncmd + schema->count + 1) * sizeof(srz_opt_t));
+    if(!merged){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return NULL;
+    }
+    memcpy(merged, cmd_opts, ncmd * sizeof(srz_opt_t));
+    size_t n = ncmd;
+    for(size_t i = 0; i < schema->count; i++){
+        if(!remap[i]){
+            remap[i] = (int32_t)n;
+            merged[n++] = schema->opts[i];
+        }
+    }
+    merged[n] = cmd_opts[ncmd];
+    return merged;
+}
+
+static inline srz_errno_t _srz_select_cmd(srz_schema_t* schema, const srz_cmd_t* cmd, void* user)
+{
+    ___srz___.cmd = cmd;
+
+    srz_opt_t* opts = cmd->reg ? cmd->reg(cmd, user) : NULL;
+    const size_t count = schema->count;
+    int32_t* remap = SRZ_MALLOC((count + 1) * sizeof(int32_t));
+    uint64_t* seen = SRZ_MALLOC((schema->words + 1) * sizeof(uint64_t));
+    if(!remap || !seen){
+        SRZ_FREE(remap);
+        SRZ_FREE(seen);
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return SRZ_ERR_NOMEM;
+    }
+    memcpy(seen, schema->seen, (schema->words + 1) * sizeof(uint64_t));
+
+    srz_opt_t* merged = NULL;
+    if(opts && opts != schema->opts){
+        opts = merged = _srz_cmd_merge(schema, opts, remap);
+    }
+    else{
+        //The same table, at most extended, so every option keeps its index
+        opts = schema->opts;
+        for(size_t i = 0; i < count; i++){
+            remap[i] = (int32_t)i;
+        }
+    }
+
+    //The limits are per parse, not per table
+    const srz_cfg_t cfg = schema->cfg;
+    const srz_limits_t used = schema->used;
+    srz_errno_t err = opts ? SRZ_ERR_NONE : SRZ_ERR_NOMEM;
+    if(!err){
+        _srz_schema_free(schema);
+        err = _srz_compile(schema, opts, &cfg);
+        schema->used   = used;
+        schema->merged = merged;
+    }
+
+    //Options given before the subcommand still count for its constraints
+    for(size_t i = 0; !err && i < count; i++){
+        if(_srz_bit_get(seen, i) && remap[i] >= 0){
+            _srz_bit_set(schema->seen, (size_t)remap[i]);
+        }
+    }
+
+    SRZ_FREE(remap);
+    SRZ_FREE(seen);
+    return err;
+}
+
+//Map the kind of match found by _srz_fuzzy_find_opt() onto an unknown or missing argument type
+static inline srz_opt_type_t _srz_fuzzy_type(srz_opt_type_t found, bool missing)
+{
+    switch(found){
+        case SRZ_OPT_SHORT: return missing ? SRZ_OPT_ARG_MISSING_SHORT : SRZ_OPT_UNKOWN_SHORT;
+        case SRZ_OPT_LONG:  return missing ? SRZ_OPT_ARG_MISSING_LONG  : SRZ_OPT_UNKOWN_LONG;
+        default:            return missing ? SRZ_OPT_ARG_MISSING_NONE  : SRZ_OPT_UNKOWN_NONE;
+    }
+}
+
+/*
+ * Streaming parser
+ * ===========================================================================
+ * Tokens are resolved one at a time against a schema compiled once, so the cost
+ * of a token does not depend on how many came before it. An option whose
+ * argument is in the next token is held until that token arrives. srz_parse()
+ * and friends feed argv through the same path.
+ */
+
+//The last occurrence of a scalar option, with cfg.last_wins
+typedef struct srz_last {
+    char* val;
+    char* own;                  //Copy of the value, when tokens do not outlive the feed
+    size_t own_size;
+    const char* tok;            //Token holding val and its argv index, for events
+    uint32_t arg;
+    uint32_t count;             //Occurrences so far, 0 when nothing is held
+    srz_opt_type_t type;
+    int32_t prev;
+    int32_t next;
+} srz_last_t;
+
+struct srz_stream {
+    srz_schema_t schema;
+    srz_opt_handler_t handler;
+    void* user;
+    srz_cands_t* cands;         //srz_candidates(), or cands_own when there is no handler
+    srz_cands_t cands_own;
+    srz_event_t* events;        //Written instead of calling the handler, when there is none
+    const srz_opt_t** event_opts; //The option of each event, when not NULL
+    size_t events_max;
+    size_t events_count;
+    bool events_grow;           //Grow events and event_opts when full, instead of counting on
+    const char* tok;            //Token being fed, and its index in argv for events
+    uint32_t arg;
+    srz_opt_t* pos;             //Positional option of the current table, or NULL
+    const srz_opt_t* pend;      //Option waiting for its argument in the next token
+    srz_opt_type_t pend_type;
+    bool opts_done;             //"--" was seen, every token after it is positional
+    bool tokens_kept;           //Tokens outlive the parse (argv), so held values need not be copied
+    bool tok_owned;             //The current token is the stream's own memory, reused once it is handled
+    srz_last_t* last;           //Scalar options held back with cfg.last_wins, indexed like the schema
+    int32_t last_head;          //Held options in order of their last occurrence
+    int32_t last_tail;
+    char* buf;                  //Partial token carried between srz_feed_bytes() calls
+    size_t len;
+    size_t size;
+};
+
+static inline srz_errno_t _srz_stream_init(srz_stream_t* stream, srz_opt_t* opts, const srz_cfg_t* cfg, srz_opt_handler_t handler, void* user)
+{
+    memset(stream, 0, sizeof(srz_stream_t));
+    stream->handler = handler;
+    stream->user    = user;
+    stream->cands   = handler ? &___srz___.cands : &stream->cands_own;
+    if(handler){
+        ___srz___.cmd       = NULL;
+        ___srz___.violation = NULL;
+    }
+
+    srz_errno_t err = _srz_compile(&stream->schema, opts, cfg);
+    if(err){
+        _srz_schema_free(&stream->schema);
+        return err;
+    }
+
+    stream->pos = _srz_get_positional(opts);
+    SRZ_PROBE(parse__start, stream, stream->schema.count);
+    return SRZ_ERR_NONE;
+}
+
+static inline void _srz_last_free(srz_stream_t* stream)
+{
+    for(size_t i = 0; stream->last && i < stream->schema.count; i++){
+        SRZ_FREE(stream->last[i].own);
+    }
+    SRZ_FREE(stream->last);
+    stream->last = NULL;
+}
+
+static inline void _srz_stream_free(srz_stream_t* stream)
+{
+    _srz_last_free(stream);
+    _srz_schema_free(&stream->schema);
+    SRZ_FREE(stream->buf);
+    stream->buf = NULL;
+}
+
+//Every way out of a parse, so parse__end fires once however it ended
+static inline srz_errno_t _srz_stream_done(srz_stream_t* stream, srz_errno_t err)
+{
+    SRZ_PROBE(parse__end, stream, err);
+    _srz_stream_free(stream);
+    return err;
+}
+
+//Copy a value srz_store() will point at out of the stream's own memory, kept with the source texts
+static inline srz_errno_t _srz_stream_keep(srz_stream_t* stream, char** val)
+{
+    const size_t len = strlen(*val) + 1;
+    const srz_errno_t err = _srz_limit_mem(&stream->schema, sizeof(char*) + len);
+    if(err){
+        return err;
+    }
+    char* text = SRZ_MALLOC(sizeof(char*) + len);
+    if(!text){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return SRZ_ERR_NOMEM;
+    }
+    memcpy(text, &___srz___.texts, sizeof(char*));
+    ___srz___.texts = text;
+    *val = memcpy(text + sizeof(char*), *val, len);
+    return SRZ_ERR_NONE;
+}
+
+//Call the handler, or in events mode append an event. Values always point into the current token.
+static inline srz_errno_t _srz_stream_call(srz_stream_t* stream, srz_opt_type_t opt_type, const srz_opt_t* opt, char* val)
+{
+    if(stream->handler){
+        if(stream->tok_owned && val && opt && opt->val.dest && opt->val.type == SRZ_VAL_STR){
+            const srz_errno_t err = _srz_stream_keep(stream, &val);
+            if(err){
+                return err;
+            }
+        }
+        SRZ_PROBE(handler__entry, opt_type, opt ? opt->ident : 0, val);
+        const srz_errno_t err = stream->handler(opt_type, opt, val, stream->user);
+        SRZ_PROBE(handler__return, err);
+        return err;
+    }
+
+    if(stream->events_count == stream->events_max && stream->events_grow){
+        const size_t max = stream->events_max ? stream->events_max * 2 : 64;
+        const srz_errno_t err = _srz_limit_mem(&stream->schema, (max - stream->events_max) * (sizeof(srz_event_t) + sizeof(srz_opt_t*)));
+        if(err){
+            return err;
+        }
+        srz_event_t* events = SRZ_REALLOC(stream->events, max * sizeof(srz_event_t));
+        if(events){
+            stream->events = events;
+        }
+        const srz_opt_t** event_opts = events ? SRZ_REALLOC(stream->event_opts, max * sizeof(srz_opt_t*)) : NULL;
+        if(!event_opts){
+            SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+            return SRZ_ERR_NOMEM;
+        }
+        stream->event_opts = event_opts;
+        stream->events_max = max;
+    }
+
+    if(stream->events_count < stream->events_max){
+        if(stream->event_opts){
+            stream->event_opts[stream->events_count] = opt;
+        }
+        srz_event_t* e = stream->events + stream->events_count;
+        e->ident = opt ? opt->ident : 0;
+        e->type  = opt_type;
+        e->arg   = stream->arg;
+        e->off   = val ? (uint32_t)(val - stream->tok) : SRZ_EVENT_NOVAL;
+        e->len   = val ? (uint32_t)strlen(val) : 0;
+    }
+    stream->events_count++;
+    return SRZ_ERR_NONE;
+}
+
+//Hold back an occurrence of a scalar option in place of any earlier one, nothing is converted yet
+static inline srz_errno_t _srz_last_hold(srz_stream_t* stream, srz_opt_type_t opt_type, const srz_opt_t* opt, char* val)
+{
+    if(!stream->last){
+        stream->last = SRZ_CALLOC(stream->schema.count, sizeof(srz_last_t));
+        if(!stream->last){
+            SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+            return SRZ_ERR_NOMEM;
+        }
+        stream->last_head = stream->last_tail = -1;
+    }
+
+    const int32_t idx = (int32_t)(opt - stream->schema.opts);
+    srz_last_t* last = stream->last + idx;
+    if(!stream->tokens_kept && val){
+        const size_t len = strlen(val) + 1;
+        if(len > last->own_size){
+            const srz_errno_t err = _srz_limit_mem(&stream->schema, len - last->own_size);
+            if(err){
+                return err;
+            }
+            char* own = SRZ_REALLOC(last->own, len);
+            if(!own){
+                SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+                return SRZ_ERR_NOMEM;
+            }
+            last->own = own;
+            last->own_size = len;
+        }
+        memcpy(last->own, val, len);
+        last->tok = last->own;
+        val = last->own;
+    }
+    else{
+        last->tok = stream->tok;
+    }
+
+    //Move it to the tail of the list, the order options are handed on in
+    if(last->count){
+        if(last->prev >= 0){ stream->last[last->prev].next = last->next; } else { stream->last_head = last->next; }
+        if(last->next >= 0){ stream->last[last->next].prev = last->prev; } else { stream->last_tail = last->prev; }
+    }
+    last->prev = stream->last_tail;
+    last->next = -1;
+    if(stream->last_tail >= 0){ stream->last[stream->last_tail].next = idx; } else { stream->last_head = idx; }
+    stream->last_tail = idx;
+
+    last->val  = val;
+    last->arg  = stream->arg;
+    last->type = opt_type;
+    last->count++;
+    return SRZ_ERR_NONE;
+}
+
+//Hand on every held option, in the order of their last occurrences
+static inline srz_errno_t _srz_last_flush(srz_stream_t* stream)
+{
+    srz_errno_t err = SRZ_ERR_NONE;
+    while(stream->last && stream->last_head >= 0 && !err){
+        srz_last_t* last = stream->last + stream->last_head;
+        const srz_opt_t* opt = stream->schema.opts + stream->last_head;
+        stream->last_head = last->next;
+
+        if(last->count > 1){
+            SRZ_DBG("`%s` given %u times, the last one wins\n", opt->lng ? opt->lng : opt->srt, last->count);
+        }
+        if(stream->handler){
+            ___srz___.schema = &stream->schema;
+            ___srz___.overrides = last->count - 1;
+        }
+        stream->tok = last->tok;
+        stream->arg = last->arg;
+        stream->tok_owned = last->tok == last->own;
+        last->count = 0;
+        err = _srz_stream_call(stream, last->type, opt, last->val);
+    }
+
+    stream->tok_owned = false;
+    stream->last_head = stream->last_tail = -1;
+    if(stream->handler){
+        ___srz___.overrides = 0;
+    }
+    return err;
+}
+
+//Hand a resolved option to the handler, and note it as given for the constraints
+static inline srz_errno_t _srz_stream_emit(srz_stream_t* stream, srz_opt_type_t opt_type, const srz_opt_t* opt, char* val)
+{
+    SRZ_PROBE(token, opt_type, opt ? opt->ident : 0, stream->tok, stream->arg);
+    if(opt && (opt_type == SRZ_OPT_SHORT || opt_type == SRZ_OPT_LONG || opt_type == SRZ_OPT_POS)){
+        _srz_bit_set(stream->schema.seen, (size_t)(opt - stream->schema.opts));
+
+        if(stream->schema.cfg.last_wins && opt_type != SRZ_OPT_POS && !opt->val.is_vector && opt->val.type != SRZ_VAL_ENUM_SET){
+            return _srz_last_hold(stream, opt_type, opt, val);
+        }
+    }
+
+    return _srz_stream_call(stream, opt_type, opt, val);
+}
+
+//Resolve a "--name[=value]" token through the long option trie. An argument in the next token is left pending.
+static inline srz_errno_t _srz_feed_long(srz_stream_t* stream, char* tok)
+{
+    srz_schema_t* schema = &stream->schema;
+    size_t len = 0;
+    while(tok[2 + len] && tok[2 + len] != '='){
+        len++;
+    }
+    const srz_slice_t name = _srz_slice(tok + 2, len);
+    char* val = tok[2 + len] == '=' ? tok + 3 + len : NULL;
+
+    srz_cands_t* cands = stream->cands;
+
+    srz_opt_type_t opt_type = SRZ_OPT_LONG;
+    srz_opt_t* opt = _srz_find_long(schema, name);
+    if(!opt && schema->cfg.abbrev){
+        opt = _srz_find_long_prefix(schema, name, cands);
+        if(!opt && cands->count){
+            //No point guessing, the user typed a prefix of each of these
+            SRZ_DBG("Ambiguous option `%s`\n", tok);
+            return _srz_stream_emit(stream, SRZ_OPT_AMBIGUOUS_LONG, cands->opts[0], val);
+        }
+    }
+
+    if(!opt){
+        SRZ_DBG("Unknown option `%s`\n", tok);
+        opt = _srz_fuzzy_find_opt(schema, tok, &opt_type, stream->cands);
+        return _srz_stream_emit(stream, _srz_fuzzy_type(opt_type, false), opt, NULL);
+    }
+
+    switch(opt->atype){
+        case SRZ_ARG_NON:
+            if(val){
+                SRZ_DBG("Unexpected argument for `%s`\n", tok);
+                opt_type = SRZ_OPT_UNKOWN_LONG;
+                val = NULL;
+            }
+            break;
+        case SRZ_ARG_OPT:
+            break;
+        case SRZ_ARG_REQ:
+        case SRZ_ARG_POS:
+            if(!val){
+                stream->pend      = opt;
+                stream->pend_type = SRZ_OPT_LONG;
+                return SRZ_ERR_NONE;
+            }
+            break;
+    }
+
+    return _srz_stream_emit(stream, opt_type, opt, val);
+}
+
+//Resolve a cluster of short options, "-abc" or "-ofile". An argument in the next token is left pending.
+static inline srz_errno_t _srz_feed_short(srz_stream_t* stream, char* tok)
+{
+    srz_errno_t err = SRZ_ERR_NONE;
+    for(char* c = tok + 1; *c && !err; c++){
+        srz_opt_t* opt = _srz_find_short(&stream->schema, *c);
+        if(!opt){
+            //Whatever follows is no more trustworthy ("-verbose"), so the cluster ends with one report
+            SRZ_DBG("Unknown option `%c` in `%s`\n", *c, tok);
+            srz_opt_type_t opt_type = SRZ_OPT_NONE;
+            opt = _srz_fuzzy_find_char(&stream->schema, *c, &opt_type, stream->cands);
+            return _srz_stream_emit(stream, _srz_fuzzy_type(opt_type, false), opt, NULL);
+        }
+
+        //An optional argument can only be attached, "-ofile"
+        if(c[1] && opt->atype != SRZ_ARG_NON){
+            return _srz_stream_emit(stream, SRZ_OPT_SHORT, opt, c + 1);
+        }
+
+        if(opt->atype == SRZ_ARG_REQ || opt->atype == SRZ_ARG_POS){
+            stream->pend      = opt;
+            stream->pend_type = SRZ_OPT_SHORT;
+            return SRZ_ERR_NONE;
+        }
+
+        err = _srz_stream_emit(stream, SRZ_OPT_SHORT, opt, NULL);
+    }
+
+    return err;
+}
+
+static inline srz_errno_t _srz_feed_positional(srz_stream_t* stream, char* tok)
+{
+    srz_schema_t* schema = &stream->schema;
+    if(schema->cfg.cmds && !___srz___.cmd && !stream->opts_done){
+        const srz_cmd_t* cmd = _srz_find_cmd(schema->cfg.cmds, tok);
+        if(cmd){
+            //Held options belong to the table being left
+            srz_errno_t err = _srz_last_flush(stream);
+            _srz_last_free(stream);
+            err = err ? err : _srz_select_cmd(schema, cmd, stream->user);
+            if(err){
+                return err;
+            }
+            stream->pos = _srz_get_positional(schema->opts);
+            return _srz_stream_emit(stream, SRZ_OPT_CMD, NULL, tok);
+        }
+    }
+
+    if(!stream->pos){
+        SRZ_WARN("%s.\n", srz_err2str_en(SRZ_ERR_POSTIONAL_FOUND));
+        return SRZ_ERR_POSTIONAL_FOUND;
+    }
+
+    return _srz_stream_emit(stream, SRZ_OPT_POS, stream->pos, tok);
+}
+
+srz_errno_t srz_stream_open(srz_stream_t** stream, srz_opt_t* opts, const srz_cfg_t* cfg, srz_opt_handler_t handler, void* user)
+{
+    *stream = SRZ_MALLOC(sizeof(srz_stream_t));
+    if(!*stream){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return SRZ_ERR_NOMEM;
+    }
+
+    const srz_errno_t err = _srz_stream_init(*stream, opts, cfg, handler, user);
+    if(err){
+        _srz_stream_done(*stream, err);
+        SRZ_FREE(*stream);
+        *stream = NULL;
+    }
+
+    return err;
+}
+
+srz_errno_t srz_feed(srz_stream_t* stream, char* token)
+{
+    srz_schema_t* schema = &stream->schema;
+    srz_errno_t err = _srz_limit(&schema->used.tokens, schema->cfg.limits.tokens, 1, SRZ_ERR_LIMIT_TOKENS);
+    if(!err && schema->cfg.limits.bytes){
+        err = _srz_limit(&schema->used.bytes, schema->cfg.limits.bytes, strlen(token) + 1, SRZ_ERR_LIMIT_BYTES);
+    }
+    if(err){
+        return err;
+    }
+
+    //Without a handler nothing can look at the globals, and the stream may be on a thread of its own
+    if(stream->handler){
+        ___srz___.schema = &stream->schema;
+    }
+    stream->cands->count = 0;
+    stream->tok = token;
+
+    if(stream->pend){
+        const srz_opt_t* opt = stream->pend;
+        stream->pend = NULL;
+        err = _srz_stream_emit(stream, stream->pend_type, opt, token);
+    }
+    else if(stream->opts_done || token[0] != '-' || token[1] == '\0'){
+        err = _srz_feed_positional(stream, token);
+    }
+    else if(token[1] != '-'){
+        err = _srz_feed_short(stream, token);
+    }
+    else if(token[2] != '\0'){
+        err = _srz_feed_long(stream, token);
+    }
+    else{
+        stream->opts_done = true;
+    }
+
+    if(stream->handler){
+        ___srz___.schema = NULL;
+    }
+    return err;
+}
+
+srz_errno_t srz_feed_bytes(srz_stream_t* stream, const char* buf, size_t len)
+{
+    while(len){
+        const char* end = memchr(buf, '\0', len);
+        const size_t seg = end ? (size_t)(end - buf) : len;
+
+        //A token that never ends must not be buffered without bound either, srz_feed() charges it once whole
+        const srz_limits_t* limits = &stream->schema.cfg.limits;
+        if(limits->bytes && stream->len + seg + 1 > limits->bytes - stream->schema.used.bytes){
+            return SRZ_ERR_LIMIT_BYTES;
+        }
+
+        if(stream->len + seg + 1 > stream->size){
+            size_t size = stream->size ? stream->size : 256;
+            while(size < stream->len + seg + 1){
+                size *= 2;
+            }
+            const srz_errno_t err = _srz_limit_mem(&stream->schema, size - stream->size);
+            if(err){
+                return err;
+            }
+            char* grown = SRZ_REALLOC(stream->buf, size);
+            if(!grown){
+                SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+                return SRZ_ERR_NOMEM;
+            }
+            stream->buf  = grown;
+            stream->size = size;
+        }
+
+        memcpy(stream->buf + stream->len, buf, seg);
+        stream->len += seg;
+        if(!end){
+            break; //The rest of this token is still to come
+        }
+
+        stream->buf[stream->len] = '\0';
+        stream->len = 0;
+        buf += seg + 1;
+        len -= seg + 1;
+
+        stream->tok_owned = true;
+        const srz_errno_t err = srz_feed(stream, stream->buf);
+        stream->tok_owned = false;
+        if(err){
+            return err;
+        }
+    }
+
+    return SRZ_ERR_NONE;
+}
+
+//Flush the last token, report a missing argument and check the constraints
+static inline srz_errno_t _srz_stream_end(srz_stream_t* stream)
+{
+    srz_errno_t err = SRZ_ERR_NONE;
+    if(stream->len){
+        //An unterminated final token
+        stream->buf[stream->len] = '\0';
+        stream->len = 0;
+        stream->tok_owned = true;
+        err = srz_feed(stream, stream->buf);
+        stream->tok_owned = false;
+    }
+
+    if(!err){
+        err = _srz_last_flush(stream);
+    }
+
+    if(!err && stream->pend){
+        SRZ_DBG("Missing argument for `%s`\n", stream->pend_type == SRZ_OPT_SHORT ? stream->pend->srt : stream->pend->lng);
+        if(stream->handler){
+            ___srz___.schema = &stream->schema;
+        }
+        _srz_cands_one(stream->cands, stream->pend, stream->pend_type == SRZ_OPT_SHORT);
+        err = _srz_stream_emit(stream, _srz_fuzzy_type(stream->pend_type, true), stream->pend, NULL);
+    }
+
+    if(!err){
+        err = _srz_rules_check(&stream->schema);
+    }
+
+    return err;
+}
+
+srz_errno_t srz_finish(srz_stream_t* stream)
+{
+    const srz_errno_t err = _srz_stream_done(stream, _srz_stream_end(stream));
+    SRZ_FREE(stream);
+    return err;
+}
+
+/*
+ * Shell completion
+ * ===========================================================================
+ * Completion words are the option names as typed ("-l", "--logging") and, for
+ * enum options, the option joined to each value ("--enum=RED", "-e=RED").
+ */
+
+static inline bool _srz_is_enum_opt(const srz_opt_t* opt)
+{
+    return _srz_is_enum_type(opt->val.type) && opt->val.enm_map && opt->atype != SRZ_ARG_NON;
+}
+
+static inline srz_errno_t _srz_trie_insert_word(srz_trie_t* trie, const char* dashes, const char* name, const char* val, const srz_opt_t* opt)
+{
+    char word[SRZ_COMPLETE_MAX];
+    const int len = snprintf(word, sizeof(word), "%s%s%s%s", dashes, name, val ? "=" : "", val ? val : "");
+    if(len < 0 || len >= (int)sizeof(word)){
+        return SRZ_ERR_NONE; //Too long to be worth completing
+    }
+
+    return _srz_trie_insert(trie, word, len, opt, NULL);
+}
+
+SRZ_COLD static inline srz_errno_t _srz_complete_build(const srz_opt_t* opts, srz_trie_t* trie)
+{
+    srz_errno_t err = _srz_trie_init(trie);
+
+    for(const srz_opt_t* opt = opts; !opt->fin && !err; opt++){
+        const char* names[2]  = { opt->srt, opt->lng };
+        const char* dashes[2] = { "-", "--" };
+
+        for(int n = 0; n < 2 && !err; n++){
+            if(isempty(names[n])){
+                continue;
+            }
+
+            err = _srz_trie_insert_word(trie, dashes[n], names[n], NULL, opt);
+            if(_srz_is_enum_opt(opt)){
+                for(const srz_enum_t* e = opt->val.enm_map; e->str && !err; e++){
+                    err = _srz_trie_insert_word(trie, dashes[n], names[n], e->str, opt);
+                }
+            }
+        }
+    }
+
+    return err;
+}
+
+//Find the node for the prefix in word, and extend word to the end of that node's label
+static inline int32_t _srz_complete_find(const srz_trie_t* trie, char* word, size_t* len)
+{
+    size_t rest = 0;
+    const int32_t node = _srz_trie_find(trie, word, *len, &rest);
+    if(node < 0 || *len + rest >= SRZ_COMPLETE_MAX){
+        return -1;
+    }
+
+    const char* label = _srz_trie_label(trie, node);
+    memcpy(word + *len, label + trie->nodes[node].len - rest, rest);
+    *len += rest;
+    return node;
+}
+
+//Print every word below node. Values hanging off "=" are only printed when asked for.
+SRZ_COLD static inline void _srz_complete_walk(const srz_trie_t* trie, int32_t node, char* word, size_t len, size_t skip, bool values, FILE* out)
+{
+    const srz_trie_node_t* n = trie->nodes + node;
+    if(n->term){
+        fprintf(out, "%.*s\n", (int)(len - skip), word + skip);
+    }
+
+    for(int32_t i = n->child; i >= 0; i = trie->nodes[i].next){
+        const char* label = _srz_trie_label(trie, i);
+        const size_t label_len = trie->nodes[i].len;
+        if(len + label_len >= SRZ_COMPLETE_MAX || (!values && label[0] == '=')){
+            continue;
+        }
+        memcpy(word + len, label, label_len);
+        _srz_complete_walk(trie, i, word, len + label_len, skip, values, out);
+    }
+}
+
+SRZ_COLD srz_errno_t srz_complete(const srz_opt_t* opts, int nwords, char** words, FILE* out)
+{
+    const char* cur  = nwords > 0 ? words[nwords - 1] : "";
+    const char* prev = nwords > 1 ? words[nwords - 2] : NULL;
+
+    srz_trie_t trie;
+    srz_errno_t err = _srz_complete_build(opts, &trie);
+    if(err){
+        _srz_trie_free(&trie);
+        return err;
+    }
+
+    char word[SRZ_COMPLETE_MAX];
+    size_t len  = 0;
+    size_t skip = 0;
+    int32_t node = -1;
+
+    //The value of an enum option given as a separate word ("-e RED") hangs off "-e="
+    if(prev && prev[0] == '-' && !strchr(prev, '=')){
+        size_t rest = 0;
+        const int32_t p = _srz_trie_find(&trie, prev, strlen(prev), &rest);
+        if(p >= 0 && !rest && trie.nodes[p].term && _srz_is_enum_opt(trie.nodes[p].opt)){
+            const int n = snprintf(word, sizeof(word), "%s=%s", prev, cur);
+            if(n > 0 && n < (int)sizeof(word)){
+                len  = n;
+                skip = strlen(prev) + 1;
+                node = _srz_complete_find(&trie, word, &len);
+            }
+            if(node < 0){
+                _srz_trie_free(&trie);
+                return SRZ_ERR_NONE;
+            }
+        }
+    }
+
+    if(node < 0 && cur[0] == '-'){
+        len = strlen(cur);
+        if(len < sizeof(word)){
+            memcpy(word, cur, len);
+            node = _srz_complete_find(&trie, word, &len);
+        }
+    }
+
+    if(node >= 0){
+        _srz_complete_walk(&trie, node, word, len, skip, skip || strchr(cur, '='), out);
+    }
+
+    _srz_trie_free(&trie);
+    return SRZ_ERR_NONE;
+}
+
+//Write str as a word inside single quotes for the shell, escaping for zsh _arguments if asked
+static inline void _srz_script_quote(const char* str, bool zsh, FILE* out)
+{
+    for(const char* c = str; c && *c; c++){
+        if(*c == '\''){
+            fputs("'\\''", out);
+            continue;
+        }
+        if(zsh && (*c == '[' || *c == ']' || *c == ':' || *c == '\\')){
+            fputc('\\', out);
+        }
+        fputc(*c, out);
+    }
+}
+
+static inline void _srz_script_enum_words(const srz_opt_t* opt, FILE* out)
+{
+    for(const srz_enum_t* e = opt->val.enm_map; e->str; e++){
+        if(e != opt->val.enm_map){
+            fputc(' ', out);
+        }
+        _srz_script_quote(e->str, false, out);
+    }
+}
+
+static inline void _srz_script_bash(const srz_opt_t* opts, const char* prog, const char* fn, FILE* out)
+{
+    fprintf(out, "# bash completion for %s, generated by shiraz\n", prog);
+    fprintf(out, "%s()\n{\n", fn);
+    fprintf(out, "    local cur=\"${COMP_WORDS[COMP_CWORD]}\"\n");
+    fprintf(out, "    local prev=\"${COMP_WORDS[COMP_CWORD-1]}\"\n");
+    fprintf(out, "    case \"$prev\" in\n");
+    for(const srz_opt_t* opt = opts; !opt->fin; opt++){
+        if(!_srz_is_enum_opt(opt)){
+            continue;
+        }
+        fprintf(out, "        ");
+        if(!isempty(opt->srt)){
+            fprintf(out, "-%s%s", opt->srt, isempty(opt->lng) ? "" : "|");
+        }
+        if(!isempty(opt->lng)){
+            fprintf(out, "--%s", opt->lng);
+        }
+        fprintf(out, ")\n            COMPREPLY=( $(compgen -W '");
+        _srz_script_enum_words(opt, out);
+        fprintf(out, "' -- \"$cur\") )\n            return;;\n");
+    }
+    fprintf(out, "    esac\n");
+    fprintf(out, "    if [[ \"$cur\" == -* ]]; then\n");
+    fprintf(out, "        COMPREPLY=( $(compgen -W '");
+    bool first = true;
+    for(const srz_opt_t* opt = opts; !opt->fin; opt++){
+        if(!isempty(opt->srt)){
+            fprintf(out, "%s-", first ? "" : " ");
+            _srz_script_quote(opt->srt, false, out);
+            first = false;
+        }
+        if(!isempty(opt->lng)){
+            fprintf(out, "%s--", first ? "" : " ");
+            _srz_script_quote(opt->lng, false, out);
+            first = false;
+        }
+    }
+    fprintf(out, "' -- \"$cur\") )\n");
+    fprintf(out, "    fi\n}\n");
+    fprintf(out, "complete -o default -F %s %s\n", fn, prog);
+}
+
+static inline void _srz_script_zsh(const srz_opt_t* opts, const char* prog, FILE* out)
+{
+    fprintf(out, "#compdef %s\n# zsh completion for %s, generated by shiraz\n", prog, prog);
+    fprintf(out, "_arguments -s");
+    for(const srz_opt_t* opt = opts; !opt->fin; opt++){
+        fprintf(out, " \\\n    ");
+        if(opt->atype == SRZ_ARG_POS){
+            fprintf(out, "'*:");
+            _srz_script_quote(isempty(opt->lng) ? "positional" : opt->lng, true, out);
+            fprintf(out, ":_files'");
+            continue;
+        }
+
+        const bool both = !isempty(opt->srt) && !isempty(opt->lng);
+        if(both){
+            fprintf(out, "'(-%s --%s)'{-%s,--%s}'", opt->srt, opt->lng, opt->srt, opt->lng);
+        }
+        else{
+            fprintf(out, "'%s%s", isempty(opt->srt) ? "--" : "-", isempty(opt->srt) ? opt->lng : opt->srt);
+        }
+
+        if(opt->atype == SRZ_ARG_OPT && !isempty(opt->lng)){
+            fputc('=', out);
+        }
+        fputc('[', out);
+        _srz_script_quote(opt->desc, true, out);
+        fputc(']', out);
+
+        if(opt->atype != SRZ_ARG_NON){
+            fprintf(out, ":value:");
+            if(_srz_is_enum_opt(opt)){
+                fputc('(', out);
+                _srz_script_enum_words(opt, out);
+                fputc(')', out);
+            }
+        }
+        fputc('\'', out);
+    }
+    fprintf(out, "\n");
+}
+
+SRZ_COLD srz_errno_t srz_completion_script(const srz_opt_t* opts, const char* prog, srz_shell_t shell, FILE* out)
+{
+    char* prog_copy = SRZ_MALLOC(strlen(prog) + 1);
+    if(!prog_copy){
+        return SRZ_ERR_NOMEM;
+    }
+    strcpy(prog_copy, prog);
+    const char* name = basename(prog_copy);
+
+    //Shell function names must be identifiers
+    char fn[SRZ_COMPLETE_MAX];
+    int len = snprintf(fn, sizeof(fn), "_srz_%s", name);
+    for(int i = 0; i < len && i < (int)sizeof(fn); i++){
+        if(!isalnum((unsigned char)fn[i])){
+            fn[i] = '_';
+        }
+    }
+
+    srz_errno_t err = SRZ_ERR_NONE;
+    switch(shell){
+        case SRZ_SHELL_BASH: _srz_script_bash(opts, name, fn, out); break;
+        case SRZ_SHELL_ZSH:  _srz_script_zsh(opts, name, out);      break;
+        default:
+            err = SRZ_ERR_UNKNOWN_SHELL;
+    }
+
+    SRZ_FREE(prog_copy);
+    return err;
+}
+
+//Handles the hidden completion options. Returns true if argv was a completion request.
+static inline bool _srz_completion_hook(int argc, char** argv, const srz_opt_t* opts)
+{
+    if(argc < 2 || !argv[1]){
+        return false;
+    }
+
+    if(strcmp(argv[1], SRZ_COMPLETE_ARG) == 0){
+        srz_complete(opts, argc - 2, argv + 2, stdout);
+        return true;
+    }
+
+    if(strcmp(argv[1], SRZ_COMPLETE_SCRIPT_ARG) == 0){
+        const char* shell = argc > 2 ? argv[2] : "bash";
+        srz_errno_t err = SRZ_ERR_UNKNOWN_SHELL;
+        if(strcmp(shell, "bash") == 0){
+            err = srz_completion_script(opts, argv[0], SRZ_SHELL_BASH, stdout);
+        }
+        else if(strcmp(shell, "zsh") == 0){
+            err = srz_completion_script(opts, argv[0], SRZ_SHELL_ZSH, stdout);
+        }
+
+        if(err){
+            SRZ_WARN("%s (`%s`)\n", srz_err2str_en(err), shell);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Help
+ * ===========================================================================
+ * Laid out in two passes over the option table: the first measures the name
+ * column and estimates the text, the second renders every line into one buffer
+ * sized from that estimate, wrapping descriptions as they are copied. The whole
+ * text then goes out in one writev(). A section renders only the options under
+ * that dotted scope.
+ */
+
+typedef struct srz_help {
+    char* buf;
+    size_t len;
+    size_t size;
+    size_t col;     //Current column of the line being rendered
+    bool nomem;
+} srz_help_t;
+
+//Room for len more bytes. The estimate is rarely short, so growing is the slow path.
+static inline bool _srz_help_room(srz_help_t* h, size_t len)
+{
+    if(h->len + len <= h->size){
+        return true;
+    }
+
+    const size_t size = h->size * 2 > h->len + len ? h->size * 2 : h->len + len;
+    char* buf = h->nomem ? NULL : SRZ_REALLOC(h->buf, size);
+    if(!buf){
+        h->nomem = true;
+        return false;
+    }
+    h->buf  = buf;
+    h->size = size;
+    return true;
+}
+
+static inline void _srz_help_put(srz_help_t* h, const char* s, size_t len)
+{
+    if(_srz_help_room(h, len)){
+        memcpy(h->buf + h->len, s, len);
+        h->len += len;
+        h->col += len;
+    }
+}
+
+static inline void _srz_help_pad(srz_help_t* h, size_t to)
+{
+    if(h->col < to && _srz_help_room(h, to - h->col)){
+        memset(h->buf + h->len, ' ', to - h->col);
+        h->len += to - h->col;
+        h->col  = to;
+    }
+}
+
+static inline void _srz_help_nl(srz_help_t* h)
+{
+    if(_srz_help_room(h, 1)){
+        h->buf[h->len++] = '\n';
+    }
+    h->col = 0;
+}
+
+//Wrap text into the description column, continuing the line already started
+static inline void _srz_help_wrap(srz_help_t* h, const char* text, size_t indent)
+{
+    for(const char* w = text; *w;){
+        while(*w == ' ' || *w == '\n'){
+            w++;
+        }
+        const size_t len = strcspn(w, " \n");
+        if(!len){
+            break;
+        }
+        if(h->col > indent && h->col + 1 + len > SRZ_HELP_WIDTH){
+            _srz_help_nl(h);
+        }
+        _srz_help_pad(h, h->col > indent ? h->col + 1 : indent);
+        _srz_help_put(h, w, len);
+        w += len;
+    }
+}
+
+static inline const char* _srz_help_type(const srz_val_t* val)
+{
+    if(!val->dest && !val->enm_map){
+        return "arg"; //Left to the handler, the type says nothing
+    }
+    switch(val->type){
+        case SRZ_VAL_BOOL:     return "bool";
+        case SRZ_VAL_FLOAT:
+        case SRZ_VAL_DOUBLE:   return "num";
+        case SRZ_VAL_STR:      return "str";
+        case SRZ_VAL_ENUM:     return "name";
+        case SRZ_VAL_ENUM_SET: return "names";
+        case SRZ_VAL_SIZE:     return "size";
+        case SRZ_VAL_DURATION: return "time";
+        default:               return "int";
+    }
+}
+
+static inline bool _srz_help_in(const srz_opt_t* opt, const char* section, size_t slen)
+{
+    return !slen || (opt->lng && strncmp(opt->lng, section, slen) == 0 && opt->lng[slen] == '.');
+}
+
+//"-s, --long=<int>", the name column of an option
+static inline size_t _srz_help_names(const srz_opt_t* opt, char* out, size_t size)
+{
+    const bool srt = !isempty(opt->srt);
+    const bool lng = !isempty(opt->lng);
+    const char* type = _srz_help_type(&opt->val);
+    const char* more = opt->val.is_vector ? (opt->val.delim ? ",..." : "...") : "";
+
+    int len = 0;
+    if(opt->atype == SRZ_ARG_POS){
+        len = snprintf(out, size, "<%s>%s", lng ? opt->lng : type, more);
+    }
+    else{
+        len = snprintf(out, size, "%s%s%s%s%s", srt ? "-" : "", srt ? opt->srt : "", srt && lng ? ", " : "", lng ? "--" : "", lng ? opt->lng : "");
+        const char* sep = lng ? "=" : " ";
+        if(len >= 0 && (size_t)len < size && opt->atype == SRZ_ARG_REQ){
+            len += snprintf(out + len, size - (size_t)len, "%s<%s>%s", sep, type, more);
+        }
+        else if(len >= 0 && (size_t)len < size && opt->atype == SRZ_ARG_OPT){
+            len += snprintf(out + len, size - (size_t)len, "[%s<%s>]%s", sep, type, more);
+        }
+    }
+
+    return len < 0 ? 0 : (size_t)len < size ? (size_t)len : size - 1;
+}
+
+//snprintf() into what is left of a buffer, returning the bytes actually written
+static inline size_t _srz_help_fmt(char* out, size_t size, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    const int len = size ? vsnprintf(out, size, fmt, args) : 0;
+    va_end(args);
+    return len < 0 ? 0 : (size_t)len < size ? (size_t)len : size - 1;
+}
+
+//Write every byte of iov, a pipe may take it in several goes
+static inline srz_errno_t _srz_writev(int fd, struct iovec* iov, int count)
+{
+    while(count){
+        const ssize_t n = writev(fd, iov, count);
+        if(n < 0 && errno == EINTR){
+            continue; //A signal arrived before anything was written
+        }
+        if(n < 0){
+            return SRZ_ERR_WRITE;
+        }
+
+        size_t done = (size_t)n;
+        while(count && done >= iov->iov_len){
+            done -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if(count){
+            iov->iov_base = (char*)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+
+    return SRZ_ERR_NONE;
+}
+
+SRZ_COLD srz_errno_t srz_help(const srz_opt_t* opts, const char* prog, const char* section, int fd)
+{
+    const size_t slen = section ? strlen(section) : 0;
+    char names[SRZ_COMPLETE_MAX];
+
+    //Pass one: the name column, and the text with descriptions at their unwrapped length
+    size_t col = 0;
+    size_t names_len = 0;
+    size_t text_len = 0;
+    size_t shown = 0;
+    for(const srz_opt_t* opt = opts; !opt->fin; opt++){
+        if(!_srz_help_in(opt, section, slen)){
+            continue;
+        }
+        const size_t len = _srz_help_names(opt, names, sizeof(names));
+        col = len > col ? len : col;
+        names_len += len;
+        text_len += opt->desc ? strlen(opt->desc) : 0;
+        for(const srz_enum_t* e = _srz_is_enum_type(opt->val.type) ? opt->val.enm_map : NULL; e && e->str; e++){
+            text_len += strlen(e->str) + 2;
+        }
+        shown++;
+    }
+    col = 2 + (col < SRZ_HELP_COL_MAX ? col : SRZ_HELP_COL_MAX) + 2;
+
+    //Each line of a description is indented by col, so it grows by about width / (width - col)
+    const size_t avail = SRZ_HELP_WIDTH > col + 16 ? SRZ_HELP_WIDTH - col : 16;
+    srz_help_t h = { .size = names_len + shown * (col + 16) + text_len / avail * SRZ_HELP_WIDTH + text_len % avail + 64 };
+    h.buf = SRZ_MALLOC(h.size);
+    if(!h.buf){
+        return SRZ_ERR_NOMEM;
+    }
+
+    //Pass two: render
+    for(const srz_opt_t* opt = opts; !opt->fin; opt++){
+        if(!_srz_help_in(opt, section, slen)){
+            continue;
+        }
+        _srz_help_pad(&h, 2);
+        _srz_help_put(&h, names, _srz_help_names(opt, names, sizeof(names)));
+        if(h.col + 2 > col){
+            _srz_help_nl(&h);
+        }
+        _srz_help_wrap(&h, opt->desc ? opt->desc : "", col);
+        if(_srz_is_enum_type(opt->val.type) && opt->val.enm_map){
+            _srz_help_wrap(&h, opt->val.type == SRZ_VAL_ENUM_SET ? "(any of:" : "(one of:", col);
+            for(const srz_enum_t* e = opt->val.enm_map; e->str; e++){
+                _srz_help_wrap(&h, e->str, col);
+                _srz_help_put(&h, e[1].str ? "," : ")", 1);
+            }
+        }
+        _srz_help_nl(&h);
+    }
+
+    //The usage line names the positionals
+    char head[SRZ_COMPLETE_MAX];
+    size_t hlen = 0;
+    hlen += _srz_help_fmt(head + hlen, sizeof(head) - hlen, "Usage: %s%s[options]", prog ? prog : "", prog ? " " : "");
+    for(const srz_opt_t* opt = opts; !opt->fin; opt++){
+        if(opt->atype == SRZ_ARG_POS){
+            hlen += _srz_help_fmt(head + hlen, sizeof(head) - hlen, " %s", _srz_help_names(opt, names, sizeof(names)) ? names : "");
+        }
+    }
+    hlen += slen ? _srz_help_fmt(head + hlen, sizeof(head) - hlen, "\n\nOptions under %s:\n", section) :
+                   _srz_help_fmt(head + hlen, sizeof(head) - hlen, "\n\nOptions:\n");
+
+    struct iovec iov[2] = { { head, hlen }, { h.buf, h.len } };
+    const srz_errno_t err = h.nomem ? SRZ_ERR_NOMEM : slen && !shown ? SRZ_ERR_HELP_SECTION : _srz_writev(fd, iov, 2);
+    if(err){
+        SRZ_WARN("%s (`%s`)\n", srz_err2str_en(err), err == SRZ_ERR_HELP_SECTION ? section : prog ? prog : "help");
+    }
+    SRZ_FREE(h.buf);
+    return err;
+}
+
+
+srz_errno_t srz_parse_ex(int argc, char** argv, srz_opt_t* opts, srz_opt_handler_t opt_handler, void* user)
+{
+    return srz_parse_cfg(argc, argv, opts, NULL, opt_handler, user);
+}
+
+srz_errno_t srz_parse_cfg(int argc, char** argv, srz_opt_t* opts, const srz_cfg_t* cfg, srz_opt_handler_t opt_handler, void* user)
+{
+#if SRZ_COMPLETION
+    //Completion requests answer straight from the option table and never run the program proper.
+    //A limited parse is taken to be untrusted input, which must not be able to end the program.
+    if(!(cfg && _srz_limited(&cfg->limits)) && _srz_completion_hook(argc, argv, opts)){
+        fflush(stdout);
+        exit(0);
+    }
+#endif
+
+    srz_stream_t stream;
+    srz_errno_t err = _srz_stream_init(&stream, opts, cfg, opt_handler, user);
+    stream.tokens_kept = true;
+    if(err){
+        return _srz_stream_done(&stream, err);
+    }
+
+    for(int i = 1; i < argc && !err; i++){
+        err = srz_feed(&stream, argv[i]);
+    }
+    if(!err){
+        err = _srz_stream_end(&stream);
+    }
+
+    return _srz_stream_done(&stream, err);
+}
+
+srz_errno_t srz_parse_events(int argc, char** argv, srz_opt_t* opts, const srz_cfg_t* cfg, srz_event_t* events, size_t max, size_t* count)
+{
+    ___srz___.cmd       = NULL;
+    ___srz___.violation = NULL;
+
+    srz_stream_t stream;
+    srz_errno_t err = _srz_stream_init(&stream, opts, cfg, NULL, NULL);
+    stream.events     = events;
+    stream.events_max = max;
+    stream.tokens_kept = true;
+    *count = 0;
+    if(err){
+        return _srz_stream_done(&stream, err);
+    }
+
+    for(int i = 1; i < argc && !err; i++){
+        stream.arg = (uint32_t)i;
+        err = srz_feed(&stream, argv[i]);
+    }
+    if(!err){
+        err = _srz_stream_end(&stream);
+    }
+    if(!err && stream.events_count > max){
+        SRZ_WARN("%s (%zu needed)\n", srz_err2str_en(SRZ_ERR_EVENTS_MAX_TOO_SMALL), stream.events_count);
+        err = SRZ_ERR_EVENTS_MAX_TOO_SMALL;
+    }
+
+    *count = stream.events_count;
+    return _srz_stream_done(&stream, err);
+}
+
+/*
+ * Sources
+ * ===========================================================================
+ * Every source gets a job: its text is read and cut into "--name=value" tokens,
+ * then resolved into events by a stream of its own, with no handler and no
+ * constraints, so jobs share nothing and run on threads of their own. The
+ * events are merged by a stream over the full configuration on the calling
+ * thread once the slowest job is done.
+ */
+
+typedef struct srz_src_job {
+    const srz_source_t* src;
+    srz_opt_t* opts;
+    srz_cfg_t cfg;
+    int argc;
+    char** argv;
+    char* text;                 //Tokens, after a link for ___srz___.texts
+    size_t len;
+    size_t size;
+    srz_event_t* events;
+    const srz_opt_t** event_opts;
+    size_t count;
+    srz_errno_t err;
+#if SRZ_PARALLEL
+    thrd_t thread;
+    bool started;
+#endif
+} srz_src_job_t;
+
+static inline bool _srz_src_falsy(const char* val, size_t len)
+{
+    static const char* falsy[] = { "", "0", "false", "no", "off" };
+    char lower[8];
+    if(len >= sizeof(lower)){
+        return false;
+    }
+    for(size_t i = 0; i < len; i++){
+        lower[i] = (char)tolower((unsigned char)val[i]);
+    }
+    lower[len] = '\0';
+
+    for(size_t i = 0; i < sizeof(falsy) / sizeof(falsy[0]); i++){
+        if(strcmp(lower, falsy[i]) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+//Append "--name=value" to the job's text. Flags take no value, and are left out when it is false.
+static inline srz_errno_t _srz_src_token(srz_src_job_t* job, const srz_schema_t* schema, srz_slice_t name, srz_slice_t val, bool has_val)
+{
+    const srz_opt_t* opt = _srz_find_long(schema, name);
+    if(opt && opt->atype == SRZ_ARG_NON){
+        if(has_val && _srz_src_falsy(val.str, val.len)){
+            return SRZ_ERR_NONE;
+        }
+        has_val = false;
+    }
+
+    const size_t need = 2 + name.len + (has_val ? 1 + val.len : 0) + 1;
+    job->len = job->len ? job->len : sizeof(char*);
+    if(job->len + need > job->size){
+        size_t size = job->size ? job->size : 256;
+        while(size < job->len + need){
+            size *= 2;
+        }
+        char* grown = SRZ_REALLOC(job->text, size);
+        if(!grown){
+            return SRZ_ERR_NOMEM;
+        }
+        job->text = grown;
+        job->size = size;
+    }
+
+    char* tok = job->text + job->len;
+    tok[0] = tok[1] = '-';
+    memcpy(tok + 2, name.str, name.len);
+    tok += 2 + name.len;
+    if(has_val){
+        *tok++ = '=';
+        memcpy(tok, val.str, val.len);
+        tok += val.len;
+    }
+    *tok = '\0';
+    job->len += need;
+    job->argc++;
+    return SRZ_ERR_NONE;
+}
+
+static inline srz_errno_t _srz_src_env(srz_src_job_t* job, const srz_schema_t* schema)
+{
+    extern char** environ;
+    const size_t plen = job->src->prefix ? strlen(job->src->prefix) : 0;
+    char name[SRZ_COMPLETE_MAX];
+
+    srz_errno_t err = SRZ_ERR_NONE;
+    for(char** env = environ; env && *env && !err; env++){
+        const char* var = *env;
+        const char* eq = strchr(var, '=');
+        if(!eq || strncmp(var, job->src->prefix ? job->src->prefix : "", plen) != 0){
+            continue;
+        }
+
+        const size_t len = (size_t)(eq - var) - plen;
+        if(len == 0 || len >= sizeof(name)){
+            continue;
+        }
+        //"__" separates the segments of a scoped name, '.' cannot be in a variable name
+        size_t nlen = 0;
+        for(size_t i = 0; i < len; i++){
+            const char c = var[plen + i];
+            if(c == '_' && i + 1 < len && var[plen + i + 1] == '_'){
+                name[nlen++] = '.';
+                i++;
+                continue;
+            }
+            name[nlen++] = c == '_' ? '-' : (char)tolower((unsigned char)c);
+        }
+        //Without a prefix every variable is a candidate, so PATH, HOME and the rest must not reach the handler as unknown options
+        if(!plen && !_srz_find_long(schema, _srz_slice(name, nlen))){
+            continue;
+        }
+        err = _srz_src_token(job, schema, _srz_slice(name, nlen), _srz_slice(eq + 1, strlen(eq + 1)), true);
+    }
+
+    return err;
+}
+
+static inline bool _srz_src_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline srz_errno_t _srz_src_file(srz_src_job_t* job, const srz_schema_t* schema)
+{
+    FILE* f = fopen(job->src->path, "rb");
+    if(!f){
+        if(job->src->optional){
+            return SRZ_ERR_NONE;
+        }
+        SRZ_WARN("%s (`%s`)\n", srz_err2str_en(SRZ_ERR_SOURCE), job->src->path);
+        return SRZ_ERR_SOURCE;
+    }
+
+    //Read it all first, a slow mount costs a few large reads rather than one per line
+    char* buf = NULL;
+    size_t len = 0;
+    size_t size = 0;
+    srz_errno_t err = SRZ_ERR_NONE;
+    while(!err){
+        if(len == size){
+            size = size ? size * 2 : 4096;
+            char* grown = SRZ_REALLOC(buf, size);
+            if(!grown){
+                err = SRZ_ERR_NOMEM;
+                break;
+            }
+            buf = grown;
+        }
+        const size_t got = fread(buf + len, 1, size - len, f);
+        len += got;
+        if(got == 0){
+            err = ferror(f) ? SRZ_ERR_SOURCE : SRZ_ERR_NONE;
+            break;
+        }
+    }
+    fclose(f);
+
+    char scoped[SRZ_COMPLETE_MAX];  //The current section's scope and a '.', then each name under it
+    size_t slen = 0;
+    for(size_t at = 0; at < len && !err;){
+        const char* line = buf + at;
+        const char* end  = memchr(line, '\n', len - at);
+        end = end ? end : buf + len;
+        at = (size_t)(end - buf) + 1;
+
+        const char* hash = memchr(line, '#', (size_t)(end - line));
+        end = hash ? hash : end;
+        while(line < end && _srz_src_space(*line)){
+            line++;
+        }
+        while(end > line && _srz_src_space(end[-1])){
+            end--;
+        }
+        if(line == end){
+            continue;
+        }
+
+        //A section is a scope, "[db.pool]" then "size = 4" is --db.pool.size=4
+        if(*line == '[' && end[-1] == ']'){
+            const char* from = line + 1;
+            const char* to   = end - 1;
+            while(from < to && _srz_src_space(*from)){
+                from++;
+            }
+            while(to > from && _srz_src_space(to[-1])){
+                to--;
+            }
+            slen = (size_t)(to - from);
+            if(slen + 1 >= sizeof(scoped)){
+                err = SRZ_ERR_SCOPE;
+                break;
+            }
+            memcpy(scoped, from, slen);
+            scoped[slen] = '.';
+            slen += slen ? 1 : 0;
+            continue;
+        }
+
+        const char* name = line;
+        while(line < end && *line != '=' && !_srz_src_space(*line)){
+            line++;
+        }
+        srz_slice_t key = _srz_slice(name, (size_t)(line - name));
+        if(slen){
+            if(slen + key.len > sizeof(scoped)){
+                err = SRZ_ERR_SCOPE;
+                break;
+            }
+            memcpy(scoped + slen, key.str, key.len);
+            key = _srz_slice(scoped, slen + key.len);
+        }
+        while(line < end && _srz_src_space(*line)){
+            line++;
+        }
+        const bool has_val = line < end;
+        if(line < end && *line == '='){
+            line++;
+            while(line < end && _srz_src_space(*line)){
+                line++;
+            }
+        }
+        err = _srz_src_token(job, schema, key, _srz_slice(line, (size_t)(end - line)), has_val);
+    }
+
+    if(err){
+        SRZ_WARN("%s (`%s`)\n", srz_err2str_en(err), job->src->path);
+    }
+    SRZ_FREE(buf);
+    return err;
+}
+
+//Point argv at the tokens in the job's text
+static inline srz_errno_t _srz_src_argv(srz_src_job_t* job)
+{
+    job->argv = SRZ_MALLOC((size_t)(job->argc + 2) * sizeof(char*));
+    if(!job->argv){
+        return SRZ_ERR_NOMEM;
+    }
+
+    job->argv[0] = (char*)(job->src->path ? job->src->path : "env");
+    char* tok = job->text + sizeof(char*);
+    for(int i = 1; i <= job->argc; i++){
+        job->argv[i] = tok;
+        tok += strlen(tok) + 1;
+    }
+    job->argv[job->argc + 1] = NULL;
+    job->argc++;
+    return SRZ_ERR_NONE;
+}
+
+static int _srz_src_run(void* arg)
+{
+    srz_src_job_t* job = arg;
+    srz_stream_t stream;
+    job->err = _srz_stream_init(&stream, job->opts, &job->cfg, NULL, NULL);
+    stream.events_grow = true;
+    stream.tokens_kept = true;
+
+    if(!job->err){
+        switch(job->src->type){
+            case SRZ_SOURCE_ARGV:
+                job->argc = job->src->argc;
+                job->argv = job->src->argv;
+                break;
+            case SRZ_SOURCE_ENV:
+            case SRZ_SOURCE_FILE:
+                job->err = job->src->type == SRZ_SOURCE_ENV ? _srz_src_env(job, &stream.schema) : _srz_src_file(job, &stream.schema);
+                if(!job->err && job->argc){
+                    job->err = _srz_src_argv(job);
+                }
+                break;
+        }
+    }
+
+    for(int i = 1; i < job->argc && !job->err; i++){
+        stream.arg = (uint32_t)i;
+        job->err = srz_feed(&stream, job->argv[i]);
+    }
+    if(!job->err){
+        job->err = _srz_stream_end(&stream);
+    }
+
+    job->events     = stream.events;
+    job->event_opts = stream.event_opts;
+    job->count      = stream.events_count;
+    _srz_stream_done(&stream, job->err);
+    return 0;
+}
+
+//Fill srz_candidates() for a replayed event, as the stream that resolved it did for its own
+static inline void _srz_src_cands(srz_stream_t* stream, srz_opt_type_t type, const srz_opt_t* opt, char* tok)
+{
+    srz_opt_type_t found = SRZ_OPT_NONE;
+    switch(type){
+        case SRZ_OPT_UNKOWN_NONE:
+        case SRZ_OPT_UNKOWN_LONG:
+        case SRZ_OPT_UNKOWN_SHORT:
+            if(tok[0] == '-' && tok[1] && tok[1] != '-'){
+                //A cluster is reported at its first unknown character
+                const char* c = tok + 1;
+                while(c[1] && _srz_find_short(&stream->schema, *c)){
+                    c++;
+                }
+                _srz_fuzzy_find_char(&stream->schema, *c, &found, stream->cands);
+            }
+            else{
+                _srz_fuzzy_find_opt(&stream->schema, tok, &found, stream->cands);
+            }
+            break;
+        case SRZ_OPT_AMBIGUOUS_LONG:
+            _srz_find_long_prefix(&stream->schema, _srz_slice(tok + 2, strcspn(tok + 2, "=")), stream->cands);
+            break;
+        case SRZ_OPT_ARG_MISSING_LONG:
+        case SRZ_OPT_ARG_MISSING_SHORT:
+            _srz_cands_one(stream->cands, opt, type == SRZ_OPT_ARG_MISSING_SHORT);
+            break;
+        default:
+            break;
+    }
+}
+
+//Hand every job's events to the handler in source order, but each option only from the last source that gives it
+static inline srz_errno_t _srz_src_merge(srz_stream_t* stream, srz_src_job_t* jobs, size_t count)
+{
+    const srz_opt_t* opts = stream->schema.opts;
+    size_t* last = SRZ_CALLOC(stream->schema.count + 1, sizeof(size_t));
+    if(!last){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return SRZ_ERR_NOMEM;
+    }
+
+    for(size_t j = 0; j < count; j++){
+        for(size_t i = 0; i < jobs[j].count; i++){
+            const srz_opt_type_t type = jobs[j].events[i].type;
+            if(type == SRZ_OPT_SHORT || type == SRZ_OPT_LONG || type == SRZ_OPT_POS){
+                last[jobs[j].event_opts[i] - opts] = j + 1;
+            }
+        }
+    }
+
+    srz_errno_t err = SRZ_ERR_NONE;
+    ___srz___.schema = &stream->schema;
+    for(size_t j = 0; j < count && !err; j++){
+        for(size_t i = 0; i < jobs[j].count && !err; i++){
+            const srz_event_t* e = jobs[j].events + i;
+            const srz_opt_t* opt = jobs[j].event_opts[i];
+            const bool given = e->type == SRZ_OPT_SHORT || e->type == SRZ_OPT_LONG || e->type == SRZ_OPT_POS;
+            if(given && last[opt - opts] != j + 1){
+                continue;
+            }
+
+            char* tok = jobs[j].argv[e->arg];
+            stream->cands->count = 0;
+            _srz_src_cands(stream, e->type, opt, tok);
+            err = _srz_stream_emit(stream, e->type, opt, e->off == SRZ_EVENT_NOVAL ? NULL : tok + e->off);
+        }
+    }
+    ___srz___.schema = NULL;
+
+    SRZ_FREE(last);
+    return err;
+}
+
+srz_errno_t srz_parse_sources(const srz_source_t* sources, size_t count, srz_opt_t* opts, const srz_cfg_t* cfg, srz_opt_handler_t handler, void* user)
+{
+    const srz_cfg_t cfg_default = SRZ_CFG_DEFAULT;
+    srz_cfg_t merged = cfg ? *cfg : cfg_default;
+    merged.cmds = NULL;
+
+    srz_stream_t stream;
+    srz_errno_t err = _srz_stream_init(&stream, opts, &merged, handler, user);
+    stream.tokens_kept = true;
+    srz_src_job_t* jobs = err ? NULL : SRZ_CALLOC(count ? count : 1, sizeof(srz_src_job_t));
+    if(!err && !jobs){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        err = SRZ_ERR_NOMEM;
+    }
+    if(err){
+        return _srz_stream_done(&stream, err);
+    }
+
+    for(size_t j = 0; j < count; j++){
+        jobs[j].src  = sources + j;
+        jobs[j].opts = opts;
+        jobs[j].cfg  = merged;
+        jobs[j].cfg.rules = NULL; //Only the merged result has to satisfy them
+    }
+
+    //The first job runs on the calling thread, so the wait is for the slowest source only
+#if SRZ_PARALLEL
+    for(size_t j = 1; j < count; j++){
+        jobs[j].started = thrd_create(&jobs[j].thread, _srz_src_run, jobs + j) == thrd_success;
+    }
+#endif
+    for(size_t j = 0; j < count; j++){
+#if SRZ_PARALLEL
+        if(jobs[j].started){
+            thrd_join(jobs[j].thread, NULL);
+            continue;
+        }
+#endif
+        _srz_src_run(jobs + j);
+    }
+
+    for(size_t j = 0; j < count && !err; j++){
+        err = jobs[j].err;
+    }
+    if(!err){
+        err = _srz_src_merge(&stream, jobs, count);
+    }
+    if(!err){
+        err = _srz_stream_end(&stream);
+    }
+
+    for(size_t j = 0; j < count; j++){
+        if(jobs[j].text){
+            memcpy(jobs[j].text, &___srz___.texts, sizeof(char*));
+            ___srz___.texts = jobs[j].text;
+        }
+        if(jobs[j].argv != sources[j].argv){
+            SRZ_FREE(jobs[j].argv);
+        }
+        SRZ_FREE(jobs[j].events);
+        SRZ_FREE(jobs[j].event_opts);
+    }
+    SRZ_FREE(jobs);
+    return _srz_stream_done(&stream, err);
+}
+
+void srz_sources_free(void)
+{
+    while(___srz___.texts){
+        char* text = ___srz___.texts;
+        memcpy(&___srz___.texts, text, sizeof(char*));
+        SRZ_FREE(text);
+    }
+}
+
+const srz_cands_t* srz_candidates(void)
+{
+    return &___srz___.cands;
+}
+
+size_t srz_overrides(void)
+{
+    return ___srz___.overrides;
+}
+
+const srz_cmd_t* srz_command(void)
+{
+    return ___srz___.cmd;
+}
+
+const srz_rule_t* srz_violation(void)
+{
+    return ___srz___.violation;
+}
+
+
+/*
+ * Value conversion
+ * ===========================================================================
+ * Values are converted straight from (pointer, length) slices of the token, so
+ * splitting a delimited token copies nothing. Vectors are a single allocation,
+ * a header followed by the elements, and the destination points at the elements.
+ * A vector read from a binary @file is a private mapping of the file instead, with
+ * the header at the end of the page mapped just before the elements.
+ */
+
+typedef struct srz_vec_hdr {
+    size_t len;
+    size_t cap;
+    size_t map; //Bytes mapped for a vector read from a binary file, 0 for the heap
+} srz_vec_hdr_t;
+
+#define _srz_vec_hdr(vec) ((srz_vec_hdr_t*)(vec) - 1)
+#define _SRZ_VEC_SHARED SIZE_MAX //map of a vector in published shared values, owned by no one
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define _SRZ_LITTLE_ENDIAN 1
+#else
+#define _SRZ_LITTLE_ENDIAN 0
+#endif
+
+//Release a mapped vector, the mapping starts one page before the elements
+static inline void _srz_vec_unmap(void* vec, size_t map)
+{
+#if SRZ_MMAP
+    if(map == _SRZ_VEC_SHARED){
+        return;
+    }
+    munmap((char*)vec - sysconf(_SC_PAGESIZE), map);
+#else
+    (void)vec;
+    (void)map;
+#endif
+}
+
+size_t srz_len(const void* vec)
+{
+    return vec ? _srz_vec_hdr(vec)->len : 0;
+}
+
+void srz_vec_free(void* vec)
+{
+    if(vec){
+        srz_vec_hdr_t* hdr = _srz_vec_hdr(vec);
+        if(hdr->map){
+            _srz_vec_unmap(vec, hdr->map);
+        }
+        else{
+            SRZ_FREE(hdr);
+        }
+    }
+}
+
+//Make room for count more elements of size elem in *vec. Returns the first new slot, or NULL.
+static inline void* _srz_vec_reserve(void** vec, size_t elem, size_t count)
+{
+    srz_vec_hdr_t* hdr = *vec ? _srz_vec_hdr(*vec) : NULL;
+    const size_t len = hdr ? hdr->len : 0;
+    size_t cap = hdr ? hdr->cap : 0;
+
+    if(count > SIZE_MAX / elem - len){
+        return NULL;
+    }
+
+    if(len + count > cap){
+        cap = cap ? cap : 4;
+        while(cap < len + count){
+            cap *= 2;
+        }
+        if(cap > (SIZE_MAX - sizeof(srz_vec_hdr_t)) / elem){
+            return NULL;
+        }
+        //A mapped vector moves to the heap the first time it grows
+        const size_t map = hdr ? hdr->map : 0;
+        hdr = map ? SRZ_MALLOC(sizeof(srz_vec_hdr_t) + cap * elem) : SRZ_REALLOC(hdr, sizeof(srz_vec_hdr_t) + cap * elem);
+        if(!hdr){
+            return NULL;
+        }
+        if(map){
+            memcpy(hdr + 1, *vec, len * elem);
+            _srz_vec_unmap(*vec, map);
+        }
+        hdr->len = len;
+        hdr->cap = cap;
+        hdr->map = 0;
+        *vec = hdr + 1;
+    }
+
+    return (char*)*vec + len * elem;
+}
+
+static inline size_t _srz_val_size(srz_val_type_t type)
+{
+    switch(type){
+        case SRZ_VAL_BOOL:   return sizeof(bool);
+        case SRZ_VAL_INT:    return sizeof(int);
+        case SRZ_VAL_INT8:   return sizeof(int8_t);
+        case SRZ_VAL_INT16:  return sizeof(int16_t);
+        case SRZ_VAL_INT32:  return sizeof(int32_t);
+        case SRZ_VAL_INT64:  return sizeof(int64_t);
+        case SRZ_VAL_UINT:   return sizeof(unsigned);
+        case SRZ_VAL_UINT8:  return sizeof(uint8_t);
+        case SRZ_VAL_UINT16: return sizeof(uint16_t);
+        case SRZ_VAL_UINT32: return sizeof(uint32_t);
+        case SRZ_VAL_UINT64: return sizeof(uint64_t);
+        case SRZ_VAL_FLOAT:  return sizeof(float);
+        case SRZ_VAL_DOUBLE: return sizeof(double);
+        case SRZ_VAL_STR:    return sizeof(char*);
+        case SRZ_VAL_ENUM:   return sizeof(int);
+        case SRZ_VAL_ENUM_SET: return sizeof(srz_ens_t);
+        case SRZ_VAL_SIZE:
+        case SRZ_VAL_DURATION:
+        case SRZ_VAL_COUNT:  return sizeof(uint64_t);
+    }
+
+    return 0;
+}
+
+//Charge count more elements of opt's vector to the limits of the schema being parsed
+static inline srz_errno_t _srz_limit_vec(const srz_opt_t* opt, size_t count)
+{
+    srz_schema_t* schema = (srz_schema_t*)___srz___.schema;
+    if(!schema){
+        return SRZ_ERR_NONE;
+    }
+
+    size_t len = srz_len(*(void**)opt->val.dest);
+    const srz_errno_t err = _srz_limit(&len, schema->cfg.limits.elems, count, SRZ_ERR_LIMIT_ELEMS);
+    return err ? err : _srz_limit_mem(schema, count * _srz_val_size(opt->val.type));
+}
+
+//Offset of the first delim in s[0, len), or len. Tests eight bytes at a time (SWAR).
+static inline size_t _srz_scan_delim(const char* s, size_t len, char delim)
+{
+    const uint64_t ones  = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t pattern = ones * (unsigned char)delim;
+
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)){
+        uint64_t word;
+        memcpy(&word, s + i, sizeof(word));
+        word ^= pattern; //Bytes equal to delim are now zero
+        if((word - ones) & ~word & highs){
+            break;
+        }
+    }
+
+    for(; i < len; i++){
+        if(s[i] == delim){
+            return i;
+        }
+    }
+
+    return len;
+}
+
+#define SRZ_SWAR_DIGITS _SRZ_LITTLE_ENDIAN
+
+//True if all eight bytes of a little endian word are ASCII digits
+static inline bool _srz_is_8digits(uint64_t word)
+{
+    return ((word & UINT64_C(0xF0F0F0F0F0F0F0F0)) |
+            (((word + UINT64_C(0x0606060606060606)) & UINT64_C(0xF0F0F0F0F0F0F0F0)) >> 4)) == UINT64_C(0x3333333333333333);
+}
+
+//Value of eight ASCII digits in a little endian word, combining pairs, then quads, then halves
+static inline uint32_t _srz_parse_8digits(uint64_t word)
+{
+    word = ((word & UINT64_C(0x0F0F0F0F0F0F0F0F)) * 2561) >> 8;
+    word = ((word & UINT64_C(0x00FF00FF00FF00FF)) * 6553601) >> 16;
+    return (uint32_t)(((word & UINT64_C(0x0000FFFF0000FFFF)) * UINT64_C(42949672960001)) >> 32);
+}
+
+//Unsigned decimal, false on a bad digit or overflow
+static inline bool _srz_parse_u64(srz_slice_t s, uint64_t* out)
+{
+    if(s.len == 0){
+        return false;
+    }
+
+    uint64_t val = 0;
+    size_t i = 0;
+#if SRZ_SWAR_DIGITS
+    //Eight digits per step, two steps cover the first sixteen
+    for(uint64_t word; i + 8 <= s.len; i += 8){
+        memcpy(&word, s.str + i, sizeof(word));
+        if(!_srz_is_8digits(word)){
+            break;
+        }
+        const uint32_t digits = _srz_parse_8digits(word);
+        if(val > (UINT64_MAX - digits) / 100000000){
+            return false;
+        }
+        val = val * 100000000 + digits;
+    }
+#endif
+    for(; i < s.len; i++){
+        const unsigned digit = (unsigned char)s.str[i] - '0';
+        if(digit > 9 || val > (UINT64_MAX - digit) / 10){
+            return false;
+        }
+        val = val * 10 + digit;
+    }
+
+    *out = val;
+    return true;
+}
+
+static inline bool _srz_parse_i64(srz_slice_t s, int64_t* out)
+{
+    const bool neg = s.len && s.str[0] == '-';
+    if(s.len && (s.str[0] == '-' || s.str[0] == '+')){
+        s.str++;
+        s.len--;
+    }
+
+    uint64_t mag = 0;
+    if(!_srz_parse_u64(s, &mag) || mag > (uint64_t)INT64_MAX + neg){
+        return false;
+    }
+
+    *out = neg ? (int64_t)(0 - mag) : (int64_t)mag;
+    return true;
+}
+
+static inline bool _srz_parse_bool(srz_slice_t s, bool* out)
+{
+    static const char* const yes[] = { "1", "true", "yes", "on", NULL };
+    static const char* const no[]  = { "0", "false", "no", "off", NULL };
+
+    for(size_t i = 0; yes[i]; i++){
+        if(_srz_slice_eq(s, _srz_slice(yes[i], strlen(yes[i])))){
+            *out = true;
+            return true;
+        }
+        if(_srz_slice_eq(s, _srz_slice(no[i], strlen(no[i])))){
+            *out = false;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static inline bool _srz_parse_enum(const srz_opt_t* opt, srz_slice_t s, int* out)
+{
+    //The interned names are used while parsing, otherwise fall back to the map itself
+    const srz_schema_t* schema = ___srz___.schema;
+    const size_t idx = _srz_schema_idx(schema, opt);
+    if(idx != SIZE_MAX){
+        const int k = _srz_find_enum(schema, idx, s);
+        if(k >= 0){
+            *out = opt->val.enm_map[k].val;
+        }
+        return k >= 0;
+    }
+
+    for(const srz_enum_t* e = opt->val.enm_map; e && e->str; e++){
+        if(strncmp(e->str, s.str, s.len) == 0 && e->str[s.len] == '\0'){
+            *out = e->val;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Unit suffixes. A suffix of up to four bytes is packed into a 32 bit key, so
+ * finding its multiplier is one integer compare per table entry.
+ */
+typedef struct srz_unit {
+    uint32_t key;
+    uint64_t mult;
+} srz_unit_t;
+
+#define _SRZ_K(a, b, c, d) ((uint32_t)(unsigned char)(a) | (uint32_t)(unsigned char)(b) << 8 | \
+                            (uint32_t)(unsigned char)(c) << 16 | (uint32_t)(unsigned char)(d) << 24)
+
+//SI multiples with or without "B", IEC multiples with "i" or "iB"
+static const srz_unit_t _srz_units_size[] = {
+    { _SRZ_K(0,0,0,0),       1 },                  { _SRZ_K('B',0,0,0),     1 },
+    { _SRZ_K('k',0,0,0),     UINT64_C(1000) },     { _SRZ_K('k','B',0,0),   UINT64_C(1000) },
+    { _SRZ_K('K',0,0,0),     UINT64_C(1000) },     { _SRZ_K('K','B',0,0),   UINT64_C(1000) },
+    { _SRZ_K('M',0,0,0),     UINT64_C(1000000) },  { _SRZ_K('M','B',0,0),   UINT64_C(1000000) },
+    { _SRZ_K('G',0,0,0),     UINT64_C(1000000000) },        { _SRZ_K('G','B',0,0), UINT64_C(1000000000) },
+    { _SRZ_K('T',0,0,0),     UINT64_C(1000000000000) },     { _SRZ_K('T','B',0,0), UINT64_C(1000000000000) },
+    { _SRZ_K('P',0,0,0),     UINT64_C(1000000000000000) },  { _SRZ_K('P','B',0,0), UINT64_C(1000000000000000) },
+    { _SRZ_K('E',0,0,0),     UINT64_C(1000000000000000000) },{ _SRZ_K('E','B',0,0), UINT64_C(1000000000000000000) },
+    { _SRZ_K('K','i',0,0),   UINT64_C(1) << 10 },  { _SRZ_K('K','i','B',0), UINT64_C(1) << 10 },
+    { _SRZ_K('M','i',0,0),   UINT64_C(1) << 20 },  { _SRZ_K('M','i','B',0), UINT64_C(1) << 20 },
+    { _SRZ_K('G','i',0,0),   UINT64_C(1) << 30 },  { _SRZ_K('G','i','B',0), UINT64_C(1) << 30 },
+    { _SRZ_K('T','i',0,0),   UINT64_C(1) << 40 },  { _SRZ_K('T','i','B',0), UINT64_C(1) << 40 },
+    { _SRZ_K('P','i',0,0),   UINT64_C(1) << 50 },  { _SRZ_K('P','i','B',0), UINT64_C(1) << 50 },
+    { _SRZ_K('E','i',0,0),   UINT64_C(1) << 60 },  { _SRZ_K('E','i','B',0), UINT64_C(1) << 60 },
+    { 0, 0 },
+};
+
+//A unit is required, except for a plain "0"
+static const srz_unit_t _srz_units_duration[] = {
+    { _SRZ_K('n','s',0,0),        1 },
+    { _SRZ_K('u','s',0,0),        UINT64_C(1000) },
+    { _SRZ_K('\xC2','\xB5','s',0), UINT64_C(1000) }, //"µs" in UTF-8
+    { _SRZ_K('m','s',0,0),        UINT64_C(1000000) },
+    { _SRZ_K('s',0,0,0),          UINT64_C(1000000000) },
+    { _SRZ_K('m',0,0,0),          UINT64_C(60000000000) },
+    { _SRZ_K('m','i','n',0),      UINT64_C(60000000000) },
+    { _SRZ_K('h',0,0,0),          UINT64_C(3600000000000) },
+    { 0, 0 },
+};
+
+static const srz_unit_t _srz_units_count[] = {
+    { _SRZ_K(0,0,0,0),   1 },
+    { _SRZ_K('k',0,0,0), UINT64_C(1000) },
+    { _SRZ_K('K',0,0,0), UINT64_C(1000) },
+    { _SRZ_K('M',0,0,0), UINT64_C(1000000) },
+    { _SRZ_K('G',0,0,0), UINT64_C(1000000000) },
+    { _SRZ_K('T',0,0,0), UINT64_C(1000000000000) },
+    { _SRZ_K('P',0,0,0), UINT64_C(1000000000000000) },
+    { _SRZ_K('E',0,0,0), UINT64_C(1000000000000000000) },
+    { 0, 0 },
+};
+
+/*
+ * One pass over "<digits>[.<digits>]<unit>", repeated if multi is set ("1h30m").
+ * Up to nine fractional digits are kept, and the fraction is scaled without
+ * a wider type: mult * frac / scale == (mult / scale) * frac + (mult % scale) * frac / scale.
+ * Returns false on bad syntax, and clears *range if the value does not fit.
+ */
+static inline bool _srz_parse_units(srz_slice_t s, const srz_unit_t* units, bool multi, uint64_t* out, bool* range)
+{
+    const char* p = s.str;
+    const char* const end = s.str + s.len;
+    uint64_t total = 0;
+
+    if(p == end){
+        return false;
+    }
+
+    while(p < end){
+        uint64_t whole = 0;
+        uint64_t frac  = 0;
+        uint64_t scale = 1;
+        size_t ndigits = 0;
+
+        for(; p < end && (unsigned)(*p - '0') <= 9; p++, ndigits++){
+            const unsigned digit = (unsigned)(*p - '0');
+            *range &= whole <= (UINT64_MAX - digit) / 10;
+            whole = whole * 10 + digit;
+        }
+        if(p < end && *p == '.'){
+            for(p++; p < end && (unsigned)(*p - '0') <= 9; p++, ndigits++){
+                if(scale < UINT64_C(1000000000)){
+                    frac = frac * 10 + (unsigned)(*p - '0');
+                    scale *= 10;
+                }
+            }
+        }
+        if(!ndigits){
+            return false;
+        }
+
+        const char* unit = p;
+        while(p < end && (unsigned)(*p - '0') > 9 && *p != '.'){
+            p++;
+        }
+        if(p - unit > 4 || (!multi && p < end)){
+            return false;
         }
 
-        const char srt_opt = srt[0];
+        uint32_t key = 0;
+        for(const char* u = unit; u < p; u++){
+            key |= (uint32_t)(unsigned char)*u << (8 * (u - unit));
+        }
 
-        if(strchr(short_opts_str, srt_opt)){
-            SRZ_FAIL("%s `%c`\n", srz_err2str_en(SRZ_ERR_SOPT_DUP), srt_opt);
-            return SRZ_ERR_SOPT_DUP;
+        uint64_t mult = 0;
+        for(const srz_unit_t* u = units; u->mult; u++){
+            mult = u->key == key ? u->mult : mult;
+        }
+        if(!mult && unit == p && p == s.str + ndigits && !whole && !frac){
+            mult = 1; //A bare zero needs no unit
+        }
+        if(!mult){
+            return false;
         }
 
-        if(SRZ_SOPTS_MAX - i < 2){
-            SRZ_FAIL("%s. Current size = %i\n", srz_err2str_en(SRZ_ERR_SOPTS_MAX_TOO_SMALL), SRZ_SOPTS_MAX);
-            return SRZ_ERR_SOPTS_MAX_TOO_SMALL;
+        *range &= whole <= UINT64_MAX / mult;
+        const uint64_t term = whole * mult + (mult / scale) * frac + (mult % scale) * frac / scale;
+        *range &= term >= whole * mult && total <= UINT64_MAX - term;
+        total += term;
+    }
+
+    *out = total;
+    return true;
+}
+
+/*
+ * Clinger's fast path. A decimal with at most 19 significant digits and a value
+ * below 2^53 is exact as a double, as are the powers of ten up to 1e22, so one
+ * correctly rounded multiply or divide gives the same bits as strtod(). Anything
+ * else (long mantissas, big exponents, hex, inf, nan) is left to strtod().
+ */
+static inline bool _srz_parse_double_fast(srz_slice_t s, double* out)
+{
+#if FLT_EVAL_METHOD == 0
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    const char* p = s.str;
+    const char* const end = s.str + s.len;
+    const bool neg = p < end && *p == '-';
+    p += p < end && (*p == '-' || *p == '+');
+
+    uint64_t mant = 0;
+    size_t digits = 0;
+    int64_t exp10 = 0;
+    for(; p < end && (unsigned)(*p - '0') <= 9; p++, digits++){
+        mant = mant * 10 + (unsigned)(*p - '0');
+    }
+    if(p < end && *p == '.'){
+        for(p++; p < end && (unsigned)(*p - '0') <= 9; p++, digits++, exp10--){
+            mant = mant * 10 + (unsigned)(*p - '0');
         }
+    }
+    if(!digits || digits > 19){
+        return false;
+    }
 
-/* GNU supports optional short arguments as an extension */
-#ifndef _GNU_SOURCE
-        if(opt->atype == SRZ_ARG_OPT){
-            SRZ_FAIL("%s '%c'\n", srz_err2str_en(SRZ_ERR_SOPT_OPTIONAL), srt_opt);
-            return SRZ_ERR_SOPT_OPTIONAL;
+    if(p < end && (*p == 'e' || *p == 'E')){
+        p++;
+        const bool eneg = p < end && *p == '-';
+        p += p < end && (*p == '-' || *p == '+');
+        int64_t e = 0;
+        const char* first = p;
+        for(; p < end && (unsigned)(*p - '0') <= 9 && e < 10000; p++){
+            e = e * 10 + (*p - '0');
         }
+        if(p == first){
+            return false;
+        }
+        exp10 += eneg ? -e : e;
+    }
+
+    if(p != end || mant > (UINT64_C(1) << 53) || exp10 < -22 || exp10 > 22){
+        return false;
+    }
+
+    double d = (double)mant;
+    d = exp10 < 0 ? d / pow10[-exp10] : d * pow10[exp10];
+    *out = neg ? -d : d;
+    return true;
+#else
+    (void)s;
+    (void)out;
+    return false;
 #endif
+}
+
+//Convert the slice s to opt's type into slot. Strings are stored in place and must be terminated.
+static inline srz_errno_t _srz_store_elem(const srz_opt_t* opt, void* slot, srz_slice_t s)
+{
+    int64_t i = 0;
+    uint64_t u = 0;
+    bool ok = true;
+    bool range = true;
+
+    switch(opt->val.type){
+        case SRZ_VAL_BOOL:   ok = _srz_parse_bool(s, (bool*)slot); break;
+        case SRZ_VAL_ENUM:
+        case SRZ_VAL_ENUM_SET: ok = _srz_parse_enum(opt, s, (int*)slot); break; //A set element converts to its value
+        case SRZ_VAL_STR:    *(char**)slot = (char*)s.str; break;
+
+        case SRZ_VAL_INT:
+            ok = _srz_parse_i64(s, &i);
+            range = i >= INT_MIN && i <= INT_MAX;
+            if(ok && range){ *(int*)slot = (int)i; }
+            break;
+        case SRZ_VAL_INT8:
+            ok = _srz_parse_i64(s, &i);
+            range = i >= INT8_MIN && i <= INT8_MAX;
+            if(ok && range){ *(int8_t*)slot = (int8_t)i; }
+            break;
+        case SRZ_VAL_INT16:
+            ok = _srz_parse_i64(s, &i);
+            range = i >= INT16_MIN && i <= INT16_MAX;
+            if(ok && range){ *(int16_t*)slot = (int16_t)i; }
+            break;
+        case SRZ_VAL_INT32:
+            ok = _srz_parse_i64(s, &i);
+            range = i >= INT32_MIN && i <= INT32_MAX;
+            if(ok && range){ *(int32_t*)slot = (int32_t)i; }
+            break;
+        case SRZ_VAL_INT64:
+            ok = _srz_parse_i64(s, &i);
+            if(ok){ *(int64_t*)slot = i; }
+            break;
+
+        case SRZ_VAL_UINT:
+            ok = _srz_parse_u64(s, &u);
+            range = u <= UINT_MAX;
+            if(ok && range){ *(unsigned*)slot = (unsigned)u; }
+            break;
+        case SRZ_VAL_UINT8:
+            ok = _srz_parse_u64(s, &u);
+            range = u <= UINT8_MAX;
+            if(ok && range){ *(uint8_t*)slot = (uint8_t)u; }
+            break;
+        case SRZ_VAL_UINT16:
+            ok = _srz_parse_u64(s, &u);
+            range = u <= UINT16_MAX;
+            if(ok && range){ *(uint16_t*)slot = (uint16_t)u; }
+            break;
+        case SRZ_VAL_UINT32:
+            ok = _srz_parse_u64(s, &u);
+            range = u <= UINT32_MAX;
+            if(ok && range){ *(uint32_t*)slot = (uint32_t)u; }
+            break;
+        case SRZ_VAL_UINT64:
+            ok = _srz_parse_u64(s, &u);
+            if(ok){ *(uint64_t*)slot = u; }
+            break;
 
-        short_opts_str[++i] = srt_opt;
+        case SRZ_VAL_SIZE:
+        case SRZ_VAL_DURATION:
+        case SRZ_VAL_COUNT: {
+            const srz_val_type_t type = opt->val.type;
+            const srz_unit_t* units = type == SRZ_VAL_SIZE ? _srz_units_size :
+                                      type == SRZ_VAL_DURATION ? _srz_units_duration : _srz_units_count;
+            ok = _srz_parse_units(s, units, type == SRZ_VAL_DURATION, &u, &range);
+            if(ok && range){ *(uint64_t*)slot = u; }
+            break;
+        }
 
-        if(opt->atype == SRZ_ARG_REQ || opt->atype == SRZ_ARG_POS){
+        case SRZ_VAL_FLOAT:
+        case SRZ_VAL_DOUBLE: {
+            //strtod() stops at the delimiter, srz_delim() refuses any it could read as part of
+            //a number, so the element does not need to be terminated
+            char* end = NULL;
+            double d = 0;
+            ok = _srz_parse_double_fast(s, &d);
+            if(!ok && s.len){
+                d = strtod(s.str, &end);
+                ok = end == s.str + s.len;
+            }
+            if(opt->val.type == SRZ_VAL_FLOAT){
+                range = d >= -FLT_MAX && d <= FLT_MAX;
+                if(ok && range){ *(float*)slot = (float)d; }
+            }
+            else if(ok){
+                *(double*)slot = d;
+            }
+            break;
+        }
+    }
+
+    if(!ok){
+        const char* hint = _srz_is_enum_type(opt->val.type) ? _srz_enum_hint(opt, s) : NULL;
+        if(hint){
+            SRZ_WARN("%s. (`%.*s`, did you mean `%s`?)\n", srz_err2str_en(SRZ_ERR_BAD_VALUE), (int)s.len, s.str, hint);
+        }
+        else{
+            SRZ_WARN("%s. (`%.*s`)\n", srz_err2str_en(SRZ_ERR_BAD_VALUE), (int)s.len, s.str);
+        }
+        return SRZ_ERR_BAD_VALUE;
+    }
+    if(!range){
+        SRZ_WARN("%s. (`%.*s`)\n", srz_err2str_en(SRZ_ERR_VALUE_RANGE), (int)s.len, s.str);
+        return SRZ_ERR_VALUE_RANGE;
+    }
+
+    return SRZ_ERR_NONE;
+}
+
+static inline size_t _srz_count_delims(const char* str, size_t len, char delim)
+{
+    size_t count = 0;
+    for(size_t at = 0; (at += _srz_scan_delim(str + at, len - at, delim)) < len; at++){
+        count++;
+    }
+
+    return count;
+}
+
+//Convert the count elements of str[0, len) into consecutive slots. A string element
+//is terminated in place, including the last one if a delimiter follows it.
+static inline srz_errno_t _srz_store_elems(const srz_opt_t* opt, char* str, size_t len, size_t count, char* slot)
+{
+    const char delim = opt->val.delim;
+    const size_t elem = _srz_val_size(opt->val.type);
+
+    size_t at = 0;
+    for(size_t n = 0; n < count; n++, slot += elem){
+        const size_t end = delim ? at + _srz_scan_delim(str + at, len - at, delim) : len;
+        if(opt->val.type == SRZ_VAL_STR && delim && str[end] == delim){
+            str[end] = '\0';
+        }
+
+        const srz_errno_t err = _srz_store_elem(opt, slot, _srz_slice(str + at, end - at));
+        if(err){
+            return err;
+        }
+        at = end + 1;
+    }
+
+    return SRZ_ERR_NONE;
+}
+
+#if SRZ_PARALLEL
+/*
+ * Parallel conversion. The value is cut into one chunk per thread, each cut moved
+ * forward to just past a delimiter. The threads count their chunk's elements, the
+ * vector grows once for all of them, then the threads convert their chunks into
+ * disjoint runs of slots with the same per element code as the serial path.
+ */
+typedef struct srz_chunk {
+    const srz_opt_t* opt;
+    char* str;
+    size_t len;
+    size_t count;
+    char* slot;
+    srz_errno_t err;
+} srz_chunk_t;
+
+static int _srz_chunk_count(void* arg)
+{
+    srz_chunk_t* chunk = arg;
+    chunk->count = _srz_count_delims(chunk->str, chunk->len, chunk->opt->val.delim) + 1;
+    return 0;
+}
+
+static int _srz_chunk_store(void* arg)
+{
+    srz_chunk_t* chunk = arg;
+    _srz_in_chunk = true;
+    chunk->err = _srz_store_elems(chunk->opt, chunk->str, chunk->len, chunk->count, chunk->slot);
+    _srz_in_chunk = false;
+    return 0;
+}
+
+static inline size_t _srz_threads(void)
+{
+    const long cpus = SRZ_THREADS ? SRZ_THREADS : sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus < 1 ? 1 : cpus > SRZ_THREADS_MAX ? SRZ_THREADS_MAX : (size_t)cpus;
+}
+
+//Run fn on every chunk, chunk 0 on the calling thread. Falls back to the calling thread if a thread cannot start.
+static inline void _srz_chunks_run(srz_chunk_t* chunks, size_t nchunks, thrd_start_t fn)
+{
+    thrd_t threads[SRZ_THREADS_MAX];
+    bool started[SRZ_THREADS_MAX] = { false };
+
+    for(size_t c = 1; c < nchunks; c++){
+        started[c] = thrd_create(threads + c, fn, chunks + c) == thrd_success;
+    }
+    fn(chunks);
+    for(size_t c = 1; c < nchunks; c++){
+        if(started[c]){
+            thrd_join(threads[c], NULL);
+        }
+        else{
+            fn(chunks + c);
+        }
+    }
+}
+
+static inline srz_errno_t _srz_store_parallel(const srz_opt_t* opt, char* optval, size_t len)
+{
+    const char delim = opt->val.delim;
+    const size_t threads = _srz_threads();
+    srz_chunk_t chunks[SRZ_THREADS_MAX];
+    size_t nchunks = 0;
+
+    //Names and bad values are looked up in indexes built on first use, so they must exist before the threads share them
+    if(opt->val.type == SRZ_VAL_ENUM && ___srz___.schema){
+        _srz_bk_build((srz_schema_t*)___srz___.schema);
+        _srz_enum_hash_build((srz_schema_t*)___srz___.schema);
+    }
+
+    for(size_t at = 0; nchunks < threads; at++){
+        //Cut at the first delimiter past an even share, the last chunk takes the rest
+        size_t end = len;
+        if(nchunks + 1 < threads){
+            const size_t cut = (nchunks + 1) * (len / threads);
+            end = cut < at ? at : cut;
+            end += _srz_scan_delim(optval + end, len - end, delim);
+        }
+
+        srz_chunk_t chunk = { .opt = opt, .str = optval + at, .len = end - at, .err = SRZ_ERR_NONE };
+        chunks[nchunks++] = chunk;
+        if(end == len){
+            break;
+        }
+        at = end;
+    }
+
+    _srz_chunks_run(chunks, nchunks, _srz_chunk_count);
+
+    size_t count = 0;
+    for(size_t c = 0; c < nchunks; c++){
+        count += chunks[c].count;
+    }
+
+    void** vec = (void**)opt->val.dest;
+    const size_t elem = _srz_val_size(opt->val.type);
+    char* slot = _srz_vec_reserve(vec, elem, count);
+    if(!slot){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return SRZ_ERR_NOMEM;
+    }
+    for(size_t c = 0; c < nchunks; c++, slot += chunks[c - 1].count * elem){
+        chunks[c].slot = slot;
+    }
+
+    _srz_chunks_run(chunks, nchunks, _srz_chunk_store);
+
+    for(size_t c = 0; c < nchunks; c++){
+        if(chunks[c].err){
+            return chunks[c].err; //Nothing is appended unless every element converts
+        }
+    }
+
+    _srz_vec_hdr(*vec)->len += count;
+    return SRZ_ERR_NONE;
+}
+#endif
+
+#if SRZ_MMAP
+//Fixed width numbers can be read straight from a raw little endian binary file
+static inline bool _srz_is_raw_type(srz_val_type_t type)
+{
+    return type != SRZ_VAL_BOOL && type != SRZ_VAL_STR && !_srz_is_enum_type(type);
+}
+
+//Append the raw elements of a binary file to a vector. An empty vector becomes a private
+//mapping of the file, so nothing is read or copied until the pages are touched.
+static inline srz_errno_t _srz_store_file(const srz_opt_t* opt, const char* path)
+{
+    if(!_SRZ_LITTLE_ENDIAN){
+        SRZ_WARN("%s `%s`\n", srz_err2str_en(SRZ_ERR_FILE_TYPE), path);
+        return SRZ_ERR_FILE_TYPE;
+    }
+
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)){
+        SRZ_WARN("%s `%s`\n", srz_err2str_en(SRZ_ERR_FILE), path);
+        if(fd >= 0){
+            close(fd);
+        }
+        return SRZ_ERR_FILE;
+    }
+
+    //Mappings start on a page boundary, so every element is aligned once the size is a whole number of them
+    const size_t elem = _srz_val_size(opt->val.type);
+    const size_t size = (size_t)st.st_size;
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if(size % elem){
+        SRZ_WARN("%s `%s` (%zu bytes, %zu byte elements)\n", srz_err2str_en(SRZ_ERR_FILE_SIZE), path, size, elem);
+        close(fd);
+        return SRZ_ERR_FILE_SIZE;
+    }
+    if(size == 0){
+        close(fd);
+        return SRZ_ERR_NONE;
+    }
+    const srz_errno_t limit = _srz_limit_vec(opt, size / elem);
+    if(limit){
+        close(fd);
+        return limit;
+    }
+    if(size > SIZE_MAX - page){
+        SRZ_WARN("%s `%s`\n", srz_err2str_en(SRZ_ERR_FILE), path);
+        close(fd);
+        return SRZ_ERR_FILE;
+    }
+
+    srz_errno_t err = SRZ_ERR_NONE;
+    void** vec = (void**)opt->val.dest;
+    if(*vec){
+        //Elements already present, copy the file in after them
+        char* slot = _srz_vec_reserve(vec, elem, size / elem);
+        void* src = slot ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        if(!slot){
+            err = SRZ_ERR_NOMEM;
+        }
+        else if(src == MAP_FAILED){
+            err = SRZ_ERR_FILE;
+        }
+        else{
+            memcpy(slot, src, size);
+            munmap(src, size);
+            _srz_vec_hdr(*vec)->len += size / elem;
+        }
+    }
+    else{
+        //Reserve a page for the header, then lay the file over the rest. The header
+        //lands in a private copy of page zero of the file, which is never seen again.
+        char* base = mmap(NULL, page + size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if(base == MAP_FAILED){
+            err = SRZ_ERR_FILE;
+        }
+        else if(mmap(base + page, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED){
+            munmap(base, page + size);
+            err = SRZ_ERR_FILE;
+        }
+        else{
+            srz_vec_hdr_t* hdr = (srz_vec_hdr_t*)(base + page) - 1;
+            hdr->len = size / elem;
+            hdr->cap = hdr->len;
+            hdr->map = page + size;
+            *vec = hdr + 1;
+        }
+    }
+
+    close(fd);
+    if(err){
+        SRZ_WARN("%s `%s`\n", srz_err2str_en(err), path);
+    }
+    return err;
+}
+#endif
+
+/*
+ * Enum sets. One bit per possible value, indexed by value, so membership is a
+ * shift and a mask whatever the size of the map.
+ */
+
+//One more than the largest value in map, or SRZ_ENS_MAX + 1 for a value out of range
+static inline size_t _srz_ens_size(const srz_enum_t* map)
+{
+    size_t size = 0;
+    for(const srz_enum_t* e = map; e && e->str; e++){
+        if(e->val < 0 || e->val >= SRZ_ENS_MAX){
+            return SRZ_ENS_MAX + 1;
+        }
+        size = (size_t)e->val + 1 > size ? (size_t)e->val + 1 : size;
+    }
+    return size;
+}
+
+static inline srz_errno_t _srz_ens_alloc(const srz_opt_t* opt, srz_ens_t* set)
+{
+    if(set->bits){
+        return SRZ_ERR_NONE;
+    }
+
+    //srz_add_es() and SRZ_DEFINE_ENS() refuse such a map, only a table built by hand gets here
+    const size_t size = _srz_ens_size(opt->val.enm_map);
+    if(size > SRZ_ENS_MAX){
+        SRZ_WARN("%s\n", srz_err2str_en(SRZ_ERR_ENS_VALUE));
+        return SRZ_ERR_ENS_VALUE;
+    }
+
+    const srz_errno_t err = _srz_limit_mem((srz_schema_t*)___srz___.schema, (size / 64 + 1) * sizeof(uint64_t));
+    if(err){
+        return err;
+    }
+    set->bits = SRZ_CALLOC(size / 64 + 1, sizeof(uint64_t));
+    if(!set->bits){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return SRZ_ERR_NOMEM;
+    }
+    set->size = size;
+    return SRZ_ERR_NONE;
+}
+
+//Apply one element of an enum set value to bits
+static inline srz_errno_t _srz_set_elem(const srz_opt_t* opt, uint64_t* bits, size_t words, srz_slice_t s)
+{
+    int val = 0;
+    char op = '+';
+    if(s.len && (s.str[0] == '+' || s.str[0] == '-')){
+        op = s.str[0];
+        s = _srz_slice(s.str + 1, s.len - 1);
+    }
+    else if((_srz_slice_eq(s, _srz_slice("all", 3)) || _srz_slice_eq(s, _srz_slice("none", 4))) && !_srz_parse_enum(opt, s, &val)){
+        op = s.str[0];
+    }
+
+    //Reports a bad name, with a hint
+    const srz_errno_t err = op == 'a' || op == 'n' ? SRZ_ERR_NONE : _srz_store_elem(opt, &val, s);
+    if(err){
+        return err;
+    }
 
-            if(SRZ_SOPTS_MAX - i < 2){
-                SRZ_FAIL("%s. Current size = %i\n", srz_err2str_en(SRZ_ERR_SOPTS_MAX_TOO_SMALL), SRZ_SOPTS_MAX);
-                return SRZ_ERR_SOPTS_MAX_TOO_SMALL;
+    switch(op){
+        case '+': bits[val / 64] |=  UINT64_C(1) << (val % 64); break;
+        case '-': bits[val / 64] &= ~(UINT64_C(1) << (val % 64)); break;
+        case 'n': memset(bits, 0, words * sizeof(uint64_t)); break;
+        case 'a':
+            for(const srz_enum_t* e = opt->val.enm_map; e->str; e++){
+                bits[e->val / 64] |= UINT64_C(1) << (e->val % 64);
             }
+            break;
+    }
+    return SRZ_ERR_NONE;
+}
+
+//Apply every element of optval in order to a copy of the set, which replaces it only if none is bad
+static inline srz_errno_t _srz_store_set(const srz_opt_t* opt, char* optval, size_t len)
+{
+    srz_ens_t* set = opt->val.dest;
+    srz_errno_t err = _srz_ens_alloc(opt, set);
+    if(err){
+        return err;
+    }
+
+    const size_t words = set->size / 64 + 1;
+    uint64_t stack[16];
+    uint64_t* bits = words <= 16 ? stack : SRZ_MALLOC(words * sizeof(uint64_t));
+    if(!bits){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return SRZ_ERR_NOMEM;
+    }
+    memcpy(bits, set->bits, words * sizeof(uint64_t));
+
+    for(size_t at = 0; at <= len && !err; at++){
+        const size_t n = opt->val.delim ? _srz_scan_delim(optval + at, len - at, opt->val.delim) : len - at;
+        err = _srz_set_elem(opt, bits, words, _srz_slice(optval + at, n));
+        at += n;
+    }
 
+    if(!err){
+        memcpy(set->bits, bits, words * sizeof(uint64_t));
+    }
+    if(bits != stack){
+        SRZ_FREE(bits);
+    }
+    return err;
+}
+
+size_t srz_ens_count(const srz_ens_t* set)
+{
+    size_t count = 0;
+    for(size_t w = 0; set->bits && w <= set->size / 64; w++){
+        count += (size_t)_srz_popcount64(set->bits[w]);
+    }
+    return count;
+}
 
-            short_opts_str[++i] = ':';
+int srz_ens_next(const srz_ens_t* set, int val)
+{
+    size_t at = val < 0 ? 0 : (size_t)val + 1;
+    if(!set->bits || at >= set->size){
+        return -1;
+    }
+
+    size_t w = at / 64;
+    uint64_t word = set->bits[w] & (~UINT64_C(0) << (at % 64));
+    while(!word){
+        if(++w > set->size / 64){
+            return -1;
         }
+        word = set->bits[w];
+    }
+    return (int)(w * 64 + (size_t)_srz_ctz64(word));
+}
+
+void srz_ens_free(srz_ens_t* set)
+{
+    SRZ_FREE(set->bits);
+    set->bits = NULL;
+    set->size = 0;
+}
 
-/* GNU supports optional short arguments as an extension */
-#ifdef _GNU_SOURCE
-        if(opt->atype == ARG_OPT){
+srz_errno_t srz_store(const srz_opt_t* opt, char* optval)
+{
+    if(!opt || !opt->val.dest){
+        return SRZ_ERR_NONE;
+    }
 
-            if(SRZ_SOPTS_MAX - i < 2){
-                SRZ_FAIL("%s. Current size = %i\n", srz_err2str_en(SRZ_ERR_SOPTS_MAX_TOO_SMALL), SRZ_SOPTS_MAX);
-                return SRZ_ERR_SOPTS_MAX_TOO_SMALL;
+    if(!optval){
+        //Flags are set by their presence, options with an absent optional argument are left alone
+        if(opt->atype == SRZ_ARG_NON && !opt->val.is_vector){
+            if(opt->val.type == SRZ_VAL_BOOL){
+                *(bool*)opt->val.dest = true;
+            }
+            else if(opt->val.type == SRZ_VAL_INT){
+                *(int*)opt->val.dest = 1;
             }
+        }
+        return SRZ_ERR_NONE;
+    }
+
+    const size_t len = strlen(optval);
+    if(opt->val.type == SRZ_VAL_ENUM_SET){
+        return _srz_store_set(opt, optval, len);
+    }
+    if(!opt->val.is_vector){
+        return _srz_store_elem(opt, opt->val.dest, _srz_slice(optval, len));
+    }
+
+#if SRZ_MMAP
+    const srz_schema_t* schema = ___srz___.schema;
+    const bool limited = schema && _srz_limited(&schema->cfg.limits);
+    if(opt->val.files && !limited && optval[0] == '@' && _srz_is_raw_type(opt->val.type)){
+        return _srz_store_file(opt, optval + 1);
+    }
+#endif
 
-            short_opts_str[++i] = ':';
+#if SRZ_PARALLEL
+    if(opt->val.delim && len >= SRZ_PARALLEL_MIN){
+        const srz_limits_t* limits = ___srz___.schema ? &___srz___.schema->cfg.limits : NULL;
+        if(limits && (limits->elems || limits->memory)){
+            const srz_errno_t err = _srz_limit_vec(opt, _srz_count_delims(optval, len, opt->val.delim) + 1);
+            if(err){
+                return err;
+            }
         }
+        return _srz_store_parallel(opt, optval, len);
+    }
 #endif
+
+    //Count the elements first so the vector grows at most once
+    const size_t count = opt->val.delim ? _srz_count_delims(optval, len, opt->val.delim) + 1 : 1;
+    srz_errno_t err = _srz_limit_vec(opt, count);
+    if(err){
+        return err;
+    }
+
+    void** vec = (void**)opt->val.dest;
+    char* slot = _srz_vec_reserve(vec, _srz_val_size(opt->val.type), count);
+    if(!slot){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return SRZ_ERR_NOMEM;
+    }
+
+    err = _srz_store_elems(opt, optval, len, count, slot);
+    if(err){
+        return err; //Nothing is appended unless every element converts
     }
 
-    return SRZ_ERR_NONE;
+    _srz_vec_hdr(*vec)->len += count;
+    return SRZ_ERR_NONE;
+}
+
+
+#if SRZ_MMAP
+/*
+ * Shared values
+ * ===========================================================================
+ * A header, one entry per option, then the values. Every value is 8 byte aligned
+ * and found by its offset from the start of the file. Vectors carry their usual
+ * header just before the elements, string vectors hold offsets rather than pointers.
+ */
+
+#define _SRZ_SHARED_MAGIC UINT32_C(0x315A5253) //"SRZ1"
+
+typedef struct srz_shared_hdr {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t size;
+} srz_shared_hdr_t;
+
+//A file bound by srz_attach(), until srz_detach()
+typedef struct srz_shared_map {
+    const srz_opt_t* opts;
+    const char* base;
+    size_t size;
+    struct srz_shared_map* next;
+} srz_shared_map_t;
+
+typedef struct srz_shared_ent {
+    uint64_t off; //0 for a NULL string or vector, or an option without a destination
+    int32_t ident;
+    uint8_t type;
+    uint8_t is_vector;
+} srz_shared_ent_t;
+
+//Reserve len bytes at the next aligned offset, copying src there unless only sizing
+static inline size_t _srz_shared_put(char* base, size_t* at, const void* src, size_t len)
+{
+    const size_t off = (*at + 7) & ~(size_t)7;
+    if(base && len){
+        memcpy(base + off, src, len);
+    }
+    *at = off + len;
+    return off;
 }
 
-static inline srz_errno_t _srz_build_long_opts(srz_opt_t opts[], struct option* long_opts)
+//Lay the values of opts out in base, or just size them when base is NULL
+static inline size_t _srz_shared_layout(const srz_opt_t* opts, size_t count, char* base)
 {
-    int i = 0;
+    size_t at = sizeof(srz_shared_hdr_t) + count * sizeof(srz_shared_ent_t);
 
-    for(srz_opt_t* opt = opts; !opt->fin; opt++, i++){
-        const char* lng = opt->lng;
+    for(size_t i = 0; i < count; i++){
+        const srz_val_t* val = &opts[i].val;
+        const size_t elem = _srz_val_size(val->type);
+        srz_shared_ent_t ent = { .ident = opts[i].ident, .type = (uint8_t)val->type, .is_vector = val->is_vector };
 
-        if(isempty(lng)){
-            continue;
+        if(!val->dest){
+            //Nothing to share
         }
-
-        if(_srz_find_long(opts, lng, &opt->ident)){
-            SRZ_FAIL("%s `%s`\n", srz_err2str_en(SRZ_ERR_LOPT_DUP), lng);
-            return SRZ_ERR_LOPT_DUP;
+        else if(val->type == SRZ_VAL_ENUM_SET){
+            const srz_ens_t* set = val->dest;
+            if(set->bits){
+                const uint64_t size = set->size;
+                ent.off = _srz_shared_put(base, &at, &size, sizeof(size));
+                _srz_shared_put(base, &at, set->bits, (set->size / 64 + 1) * sizeof(uint64_t));
+            }
         }
-
-        if(SRZ_LOPTS_MAX - i < 2){
-            SRZ_FAIL("%s. Current size = %i\n", srz_err2str_en(SRZ_ERR_LOPTS_MAX_TOO_SMALL), SRZ_LOPTS_MAX);
-            return SRZ_ERR_LOPTS_MAX_TOO_SMALL;
+        else if(!val->is_vector){
+            const char* str = val->type == SRZ_VAL_STR ? *(char**)val->dest : NULL;
+            if(val->type != SRZ_VAL_STR){
+                ent.off = _srz_shared_put(base, &at, val->dest, elem);
+            }
+            else if(str){
+                ent.off = _srz_shared_put(base, &at, str, strlen(str) + 1);
+            }
+        }
+        else if(*(void**)val->dest){
+            const void* vec = *(void**)val->dest;
+            const srz_vec_hdr_t hdr = { .len = srz_len(vec), .cap = srz_len(vec), .map = _SRZ_VEC_SHARED };
+            _srz_shared_put(base, &at, &hdr, sizeof(hdr));
+            ent.off = at;
+
+            if(val->type != SRZ_VAL_STR){
+                _srz_shared_put(base, &at, vec, hdr.len * elem);
+            }
+            else{
+                at += hdr.len * sizeof(uint64_t);
+                for(size_t j = 0; j < hdr.len; j++){
+                    const char* str = ((char* const*)vec)[j];
+                    const uint64_t off = _srz_shared_put(base, &at, str, strlen(str) + 1);
+                    if(base){
+                        memcpy(base + ent.off + j * sizeof(off), &off, sizeof(off));
+                    }
+                }
+            }
         }
 
-        long_opts[i].name = opt->lng;
-        long_opts[i].val  = 0;
-        switch(opt->atype){
-            case SRZ_ARG_NON:   long_opts[i].has_arg = no_argument;         break;
-            case SRZ_ARG_OPT:   long_opts[i].has_arg = optional_argument;   break;
-            case SRZ_ARG_REQ:   long_opts[i].has_arg = required_argument;   break;
-            case SRZ_ARG_POS:   long_opts[i].has_arg = required_argument;   break;
+        if(base){
+            memcpy(base + sizeof(srz_shared_hdr_t) + i * sizeof(ent), &ent, sizeof(ent));
         }
+    }
 
+    return at;
+}
+
+static inline const srz_opt_t* _srz_shared_opts(const srz_opt_t* opts, size_t* count)
+{
+    if(!opts && !___srz___.init_complete){
+        return NULL;
     }
 
-    return SRZ_ERR_NONE;
+    opts = opts ? opts : ___srz___.opts;
+    for(*count = 0; !opts[*count].fin; (*count)++);
+    return opts;
 }
 
-void _srz_debug_dump_long(struct option* opts)
+//An anonymous file, named only while it is being created when there is no memfd
+static inline int _srz_shared_fd(void)
 {
-#ifdef SRZ_DEBUG
-    int i = 0;
-    for(struct option* opt = opts; opt->name; opt++, i++){
-        printf("%i - name=%s, has_arg=%i, flag=%p, val=%i\n",
-               i,
-               opt->name,
-               opt->has_arg,
-               (void*)opt->flag,
-               opt->val);
+#ifdef MFD_CLOEXEC
+    return memfd_create("shiraz", MFD_CLOEXEC);
+#else
+    static unsigned serial;
+    char name[64];
+    snprintf(name, sizeof(name), "/shiraz-%ld-%u", (long)getpid(), serial++);
+    const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd >= 0){
+        shm_unlink(name);
     }
+    return fd;
 #endif
 }
 
-
-srz_errno_t _srz_do_getop(
-        int argc,
-        char** argv,
-        srz_opt_t opts[],
-        srz_opt_handler_t opt_handler,
-        char* short_opts_str,
-        struct option* long_opts,
-        void* user
-    )
+srz_errno_t srz_publish(const srz_opt_t* opts, int* fd)
 {
-    srz_errno_t err = SRZ_ERR_NONE;
+    size_t count;
+    if(!(opts = _srz_shared_opts(opts, &count))){
+        return SRZ_ERR_NO_OPTS_ADDED;
+    }
+
+    const size_t size = _srz_shared_layout(opts, count, NULL);
+    char* base = SRZ_CALLOC(1, size);
+    if(!base){
+        SRZ_WARN("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return SRZ_ERR_NOMEM;
+    }
 
-    int optindx = -1;
-    int opt = -1;
+    const srz_shared_hdr_t hdr = { .magic = _SRZ_SHARED_MAGIC, .count = (uint32_t)count, .size = size };
+    memcpy(base, &hdr, sizeof(hdr));
+    _srz_shared_layout(opts, count, base);
 
-    while(1){
-        opt = getopt_long(argc, argv, short_opts_str, long_opts, &optindx);
-        if(opt == -1){
+    *fd = _srz_shared_fd();
+    size_t done = 0;
+    for(ssize_t n = 0; *fd >= 0 && done < size; done += (size_t)n){
+        if((n = write(*fd, base + done, size - done)) <= 0){
             break;
         }
+    }
+    SRZ_FREE(base);
 
-        srz_opt_t* srz_opt = NULL;
-        srz_opt_type_t opt_type = SRZ_OPT_NONE;
-        switch(opt){
-            case 0:
-                srz_opt = _srz_find_long(opts, long_opts[optindx].name, NULL);
-                if(!srz_opt){
-                    SRZ_FAIL("%s. (`%s`)\n", srz_err2str_en(SRZ_ERR_INTERNAL), long_opts[optindx].name);
-                    return SRZ_ERR_INTERNAL;
-                }
-                opt_type = SRZ_OPT_LONG;
-                break;
-            case 1:
-                srz_opt = _srz_get_positional(opts);
-                if(!srz_opt){
-                    SRZ_WARN("%s.\n", srz_err2str_en(SRZ_ERR_POSTIONAL_FOUND));
-                    return SRZ_ERR_POSTIONAL_FOUND;
-                }
-                opt_type = SRZ_OPT_LONG;
-                break;
+    if(done < size){
+        SRZ_WARN("%s\n", srz_err2str_en(SRZ_ERR_SHARED));
+        if(*fd >= 0){
+            close(*fd);
+        }
+        *fd = -1;
+        return SRZ_ERR_SHARED;
+    }
 
-            case '?':
-                SRZ_DBG("Unknown option `%c` %s %i %s`\n", optopt, optarg, optind, argv[optind -1]);
-                srz_opt = _srz_fuzzy_find_opt(opts,argv[optind -1], &opt_type);
-                switch(opt_type){
-                    case SRZ_OPT_NONE:
-                        opt_type = SRZ_OPT_UNKOWN_NONE;
-                        break;
-                    case SRZ_OPT_SHORT:
-                        opt_type = SRZ_OPT_UNKOWN_SHORT;
-                        break;
-                    case SRZ_OPT_LONG:
-                        opt_type = SRZ_OPT_UNKOWN_LONG;
-                        break;
-                    default:
-                        SRZ_FAIL("%s. (`%c`)\n", srz_err2str_en(SRZ_ERR_INTERNAL2), opt_type);
-                        return SRZ_ERR_INTERNAL2;
-                }
-                break;
+    return SRZ_ERR_NONE;
+}
 
-            case ':':
-                SRZ_DBG("Missing argument for `%c` %s %i %s\n", optopt, optarg, optind, argv[optind -1]);
-                srz_opt = _srz_fuzzy_find_opt(opts,argv[optind -1], &opt_type);
-
-                switch(opt_type){
-                    case SRZ_OPT_NONE:
-                        opt_type = SRZ_OPT_ARG_MISSING_NONE;
-                        break;
-                    case SRZ_OPT_SHORT:
-                        opt_type = SRZ_OPT_ARG_MISSING_SHORT;
-                        break;
-                    case SRZ_OPT_LONG:
-                        opt_type = SRZ_OPT_ARG_MISSING_LONG;
-                        break;
-                    default:
-                        SRZ_FAIL("%s. (`%c`)\n", srz_err2str_en(SRZ_ERR_INTERNAL2), opt_type);
-                        return SRZ_ERR_INTERNAL2;
-                }
-                break;
+static inline void _srz_init(void);
 
-            default:
-                srz_opt = _srz_find_short(opts,opt);
-                opt_type = SRZ_OPT_SHORT;
-                if(!srz_opt){
-                    SRZ_FAIL("%s. (`%c`)\n", srz_err2str_en(SRZ_ERR_INTERNAL), opt);
-                    return SRZ_ERR_INTERNAL;
-                }
+//The entry describes the option, and its value lies inside the file
+static inline bool _srz_shared_ent_ok(const srz_opt_t* opt, const srz_shared_ent_t* ent, const char* base, size_t size)
+{
+    const srz_val_t* val = &opt->val;
+    if(ent->ident != opt->ident || ent->type != val->type || ent->is_vector != val->is_vector || ent->off >= size){
+        return false;
+    }
+    if(!ent->off){
+        return !val->dest || val->is_vector || val->type == SRZ_VAL_STR || val->type == SRZ_VAL_ENUM_SET;
+    }
+    if(val->type == SRZ_VAL_ENUM_SET){
+        uint64_t bits = 0;
+        if(size - ent->off >= sizeof(bits)){
+            memcpy(&bits, base + ent->off, sizeof(bits));
         }
+        return bits == _srz_ens_size(val->enm_map) && (bits / 64 + 2) * sizeof(uint64_t) <= size - ent->off;
+    }
+    if(!val->is_vector){
+        return val->type == SRZ_VAL_STR ? memchr(base + ent->off, '\0', size - ent->off) != NULL
+                                        : _srz_val_size(val->type) <= size - ent->off;
+    }
 
-        err = opt_handler(opt_type, srz_opt, optarg, user);
-        if(err){
-            return err;
+    const size_t elem = val->type == SRZ_VAL_STR ? sizeof(uint64_t) : _srz_val_size(val->type);
+    const size_t len = ent->off >= sizeof(srz_vec_hdr_t) ? srz_len(base + ent->off) : SIZE_MAX;
+    if(len > (size - ent->off) / elem){
+        return false;
+    }
+
+    //Each string of a vector lies in the file too, and ends there
+    for(size_t j = 0; val->type == SRZ_VAL_STR && j < len; j++){
+        uint64_t off;
+        memcpy(&off, base + ent->off + j * sizeof(off), sizeof(off));
+        if(off < sizeof(srz_shared_hdr_t) || off >= size || !memchr(base + off, '\0', size - off)){
+            return false;
         }
+    }
+    return true;
+}
 
+srz_errno_t srz_attach(const srz_opt_t* opts, int fd)
+{
+    size_t count;
+    if(!(opts = _srz_shared_opts(opts, &count))){
+        return SRZ_ERR_NO_OPTS_ADDED;
     }
 
-    srz_opt_t* srz_opt = _srz_get_positional(opts);
-    if(optind < argc){
-        if(!srz_opt){
-            SRZ_WARN("%s.\n", srz_err2str_en(SRZ_ERR_POSTIONAL_FOUND));
-            return SRZ_ERR_POSTIONAL_FOUND;
+    struct stat st;
+    const char* base = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(srz_shared_hdr_t)){
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    srz_shared_map_t* map = base == MAP_FAILED ? NULL : SRZ_MALLOC(sizeof(srz_shared_map_t));
+    if(!map){
+        SRZ_WARN("%s\n", srz_err2str_en(base == MAP_FAILED ? SRZ_ERR_SHARED : SRZ_ERR_NOMEM));
+        if(base != MAP_FAILED){
+            munmap((void*)base, (size_t)st.st_size);
         }
+        return base == MAP_FAILED ? SRZ_ERR_SHARED : SRZ_ERR_NOMEM;
+    }
 
-        for(; optind < argc; optind++){
-            err = opt_handler(SRZ_OPT_POS, srz_opt, argv[optind], user);
-            if(err){
-                return err;
+    //Check everything before binding anything, so a bad file leaves the table alone
+    const size_t size = (size_t)st.st_size;
+    const srz_shared_hdr_t* hdr = (const srz_shared_hdr_t*)base;
+    const srz_shared_ent_t* ents = (const srz_shared_ent_t*)(hdr + 1);
+    bool ok = hdr->magic == _SRZ_SHARED_MAGIC && hdr->size == size && hdr->count == count &&
+              count <= (size - sizeof(*hdr)) / sizeof(*ents);
+    for(size_t i = 0; ok && i < count; i++){
+        ok = _srz_shared_ent_ok(&opts[i], &ents[i], base, size);
+    }
+    if(!ok){
+        SRZ_WARN("%s\n", srz_err2str_en(SRZ_ERR_SHARED_LAYOUT));
+        munmap((void*)base, size);
+        SRZ_FREE(map);
+        return SRZ_ERR_SHARED_LAYOUT;
+    }
+
+    _srz_init();
+    *map = (srz_shared_map_t){ .opts = opts, .base = base, .size = size, .next = ___srz___.shared };
+    ___srz___.shared = map;
+
+    for(size_t i = 0; i < count; i++){
+        const srz_val_t* val = &opts[i].val;
+        const char* at = ents[i].off ? base + ents[i].off : NULL;
+
+        if(!val->dest){
+            continue;
+        }
+        else if(val->type == SRZ_VAL_ENUM_SET){
+            //The bitset is small and freed with srz_ens_free(), so it is copied out
+            srz_ens_t* set = val->dest;
+            srz_ens_free(set);
+            if(at){
+                uint64_t size;
+                memcpy(&size, at, sizeof(size));
+                const srz_errno_t err = _srz_ens_alloc(&opts[i], set);
+                if(err){
+                    return err;
+                }
+                memcpy(set->bits, at + sizeof(size), ((size_t)size / 64 + 1) * sizeof(uint64_t));
+                set->size = (size_t)size;
+            }
+        }
+        else if(!val->is_vector && val->type != SRZ_VAL_STR){
+            memcpy(val->dest, at, _srz_val_size(val->type));
+        }
+        else if(!val->is_vector || val->type != SRZ_VAL_STR || !at){
+            *(const void**)val->dest = at;
+        }
+        else{
+            //Pointers differ from process to process, so they are rebuilt privately
+            const size_t len = srz_len(at);
+            void** vec = (void**)val->dest;
+            *vec = NULL;
+            char** strs = _srz_vec_reserve(vec, sizeof(char*), len);
+            if(!strs){
+                SRZ_WARN("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+                return SRZ_ERR_NOMEM;
             }
+            for(size_t j = 0; j < len; j++){
+                uint64_t off;
+                memcpy(&off, at + j * sizeof(off), sizeof(off));
+                strs[j] = (char*)base + off;
+            }
+            _srz_vec_hdr(*vec)->len = len;
         }
     }
 
-    return err;
+    return SRZ_ERR_NONE;
 }
 
-srz_errno_t srz_parse_ex(int argc, char** argv, srz_opt_t* opts, srz_opt_handler_t opt_handler, void* user)
+srz_errno_t srz_detach(const srz_opt_t* opts)
 {
-
-    srz_errno_t err = SRZ_ERR_NONE;
-    if(_srz_no_short_long(opts)){
-        SRZ_FAIL("%s.\n", srz_err2str_en(SRZ_ERR_NO_SHORT_LONG));
-        return SRZ_ERR_NO_SHORT_LONG;
+    size_t count;
+    if(!(opts = _srz_shared_opts(opts, &count))){
+        return SRZ_ERR_NO_OPTS_ADDED;
     }
 
-    if(_srz_positional_count(opts) > 1){
-        SRZ_FAIL("%s.\n", srz_err2str_en(SRZ_ERR_MULTI_POSITIONAL));
-        return SRZ_ERR_MULTI_POSITIONAL;
+    srz_shared_map_t** link = &___srz___.shared;
+    while(*link && (*link)->opts != opts){
+        link = &(*link)->next;
     }
-
-    char short_opts_str[SRZ_SOPTS_MAX];
-    memset(short_opts_str, 0, SRZ_SOPTS_MAX);
-    err = _srz_build_short_opts(opts, short_opts_str);
-    if(err){
-        SRZ_FAIL("Could not build short options string\n");
-        return err;
+    srz_shared_map_t* map = *link;
+    if(!map){
+        return SRZ_ERR_SHARED;
     }
 
-    struct option long_opts[SRZ_LOPTS_MAX];
-    memset(&long_opts, 0, sizeof(struct option) * SRZ_LOPTS_MAX);
-    err = _srz_build_long_opts(opts, long_opts);
-    if(err){
-        SRZ_FAIL("Could not build long options structure\n");
-        return err;
+    //Scalars were copied out and stay, everything pointing into the file goes
+    for(size_t i = 0; i < count; i++){
+        const srz_val_t* val = &opts[i].val;
+        if(!val->dest){
+            continue;
+        }
+        else if(val->type == SRZ_VAL_ENUM_SET){
+            srz_ens_free(val->dest);
+        }
+        else if(val->is_vector && val->type == SRZ_VAL_STR){
+            srz_vec_free(*(void**)val->dest);
+            *(void**)val->dest = NULL;
+        }
+        else if(val->is_vector || val->type == SRZ_VAL_STR){
+            const char* at = *(const char**)val->dest;
+            if(at >= map->base && at < map->base + map->size){
+                *(void**)val->dest = NULL;
+            }
+        }
     }
 
-    _srz_debug_dump_long(long_opts);
-
-    _srz_do_getop(argc,argv,opts,opt_handler,short_opts_str,long_opts, user);
-
-    return err;
+    *link = map->next;
+    munmap((void*)map->base, map->size);
+    SRZ_FREE(map);
+    return SRZ_ERR_NONE;
 }
+#endif
 
 
 
@@ -953,11 +5513,70 @@ srz_t ___srz___;
 static inline void _srz_init(void)
 {
     if(!___srz___.init_complete){
+        const srz_cfg_t cfg_default = SRZ_CFG_DEFAULT;
         memset(&___srz___, 0, sizeof(srz_t));
+        ___srz___.cfg = cfg_default;
         ___srz___.init_complete = 1;
     }
 }
 
+srz_cfg_t* srz_cfg(void)
+{
+    _srz_init();
+    return &___srz___.cfg;
+}
+
+//lopt under the scope set with srz_scope(), or lopt itself. NULL if out of memory.
+//Scoped names are kept for the life of the process.
+static inline char* _srz_scoped(char* lopt)
+{
+    if(!lopt || !___srz___.scope){
+        return lopt;
+    }
+
+    const size_t slen = strlen(___srz___.scope);
+    const size_t len  = strlen(lopt);
+    char* text = SRZ_MALLOC(sizeof(char*) + slen + 1 + len + 1);
+    if(!text){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return NULL;
+    }
+    memcpy(text, &___srz___.kept, sizeof(char*));
+    ___srz___.kept = text;
+
+    char* name = text + sizeof(char*);
+    memcpy(name, ___srz___.scope, slen);
+    name[slen] = '.';
+    memcpy(name + slen + 1, lopt, len + 1);
+    return name;
+}
+
+srz_enum_t* srz_enum_fin(srz_enum_t* map, size_t count)
+{
+    if(!map || !count){
+        return map;
+    }
+    for(size_t i = 0; i < count; i++){
+        if(!map[i].str){
+            return map;
+        }
+    }
+
+    //The first entry holds the link
+    _srz_init();
+    srz_enum_t* copy = SRZ_MALLOC((count + 2) * sizeof(srz_enum_t));
+    if(!copy){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_NOMEM));
+        return NULL;
+    }
+    memcpy(copy, &___srz___.kept, sizeof(char*));
+    ___srz___.kept = (char*)copy;
+
+    memcpy(copy + 1, map, count * sizeof(srz_enum_t));
+    copy[count + 1] = (srz_enum_t)SRZ_ENUM_FIN;
+    return copy + 1;
+}
+
 static inline int _srz_add_check()
 {
     if(SRZ_OPTS_MAX - ___srz___.opt_idx < 2){
@@ -975,7 +5594,7 @@ _srz_add_x(N,T)                                             \
     _srz_init();                                            \
                                                             \
     if(_srz_add_check()){                                   \
-        ___srz___.errno = SRZ_ERR_SOPTS_MAX_TOO_SMALL;      \
+        ___srz___.err_no = SRZ_ERR_SOPTS_MAX_TOO_SMALL;      \
         return -1 ;                                         \
     }                                                       \
                                                             \
@@ -983,7 +5602,11 @@ _srz_add_x(N,T)                                             \
     opt->fin        = 0;                                    \
     opt->ident      = ___srz___.opt_idx;                    \
     opt->srt        = sopt;                                 \
-    opt->lng        = lopt;                                 \
+    opt->lng        = _srz_scoped(lopt);                    \
+    if(lopt && !opt->lng){                                  \
+        ___srz___.err_no = SRZ_ERR_NOMEM;                    \
+        return -1;                                          \
+    }                                                       \
     opt->desc       = desc;                                 \
     opt->atype      = SRZ_ARG_REQ;                          \
     opt->val.type   = O;                                    \
@@ -1006,7 +5629,7 @@ _srz_add_x_imp(i, i16, int16_t,  SRZ_VAL_INT16)
 _srz_add_x_imp(i, i32, int32_t,  SRZ_VAL_INT32)
 _srz_add_x_imp(i, i64, int64_t,  SRZ_VAL_INT64)
 _srz_add_x_imp(i, b,   bool,     SRZ_VAL_BOOL)
-_srz_add_x_imp(u, u,   unsigned, SRZ_VAL_INT)
+_srz_add_x_imp(u, u,   unsigned, SRZ_VAL_UINT)
 _srz_add_x_imp(u, u8,  uint8_t,  SRZ_VAL_UINT8)
 _srz_add_x_imp(u, u16, uint16_t, SRZ_VAL_UINT16)
 _srz_add_x_imp(u, u32, uint32_t, SRZ_VAL_UINT32)
@@ -1021,7 +5644,7 @@ _srz_add_X(N,T)                                             \
     _srz_init();                                            \
                                                             \
     if(_srz_add_check()){                                   \
-        ___srz___.errno = SRZ_ERR_SOPTS_MAX_TOO_SMALL;      \
+        ___srz___.err_no = SRZ_ERR_SOPTS_MAX_TOO_SMALL;      \
         return -1 ;                                         \
     }                                                       \
                                                             \
@@ -1029,12 +5652,19 @@ _srz_add_X(N,T)                                             \
     opt->ident = ___srz___.opt_idx;                         \
     opt->fin   = 0;                                         \
     opt->srt   = sopt;                                      \
-    opt->lng   = lopt;                                      \
+    opt->lng   = _srz_scoped(lopt);                         \
+    if(lopt && !opt->lng){                                  \
+        ___srz___.err_no = SRZ_ERR_NOMEM;                    \
+        return -1;                                          \
+    }                                                       \
     opt->desc  = desc;                                      \
     opt->atype = SRZ_ARG_REQ;                               \
     opt->val.type = O;                                      \
     opt->val.dest = dest;                                   \
     opt->val.is_vector = 1;                                 \
+    opt->val.delim = '\0';                                  \
+                                                            \
+    *dest = NULL;                                           \
                                                             \
     ___srz___.opt_idx++;                                    \
     opt = ___srz___.opts + ___srz___.opt_idx;               \
@@ -1064,7 +5694,7 @@ int srz_add_P(char* sopt, char* lopt, char* desc, char*** dest)
     _srz_init();
 
     if(_srz_add_check()){
-        ___srz___.errno = SRZ_ERR_SOPTS_MAX_TOO_SMALL;
+        ___srz___.err_no = SRZ_ERR_SOPTS_MAX_TOO_SMALL;
         return -1 ;
     }
 
@@ -1072,12 +5702,19 @@ int srz_add_P(char* sopt, char* lopt, char* desc, char*** dest)
     opt->ident          = ___srz___.opt_idx;
     opt->fin            = 0;
     opt->srt            = sopt;
-    opt->lng            = lopt;
+    opt->lng            = _srz_scoped(lopt);
+    if(lopt && !opt->lng){
+        ___srz___.err_no = SRZ_ERR_NOMEM;
+        return -1;
+    }
     opt->desc           = desc;
     opt->atype          = SRZ_ARG_POS;
     opt->val.type       = SRZ_VAL_STR;
     opt->val.dest       = dest;
     opt->val.is_vector  = 1;
+    opt->val.delim      = '\0';
+
+    *dest = NULL;
 
     ___srz___.opt_idx++;
     opt = ___srz___.opts + ___srz___.opt_idx;
@@ -1092,7 +5729,7 @@ int srz_add_e(char* sopt, char* lopt, char* desc, int* dest, int init, srz_enum_
     _srz_init();
 
     if(_srz_add_check()){
-        ___srz___.errno = SRZ_ERR_SOPTS_MAX_TOO_SMALL;
+        ___srz___.err_no = SRZ_ERR_SOPTS_MAX_TOO_SMALL;
         return -1 ;
     }
 
@@ -1100,7 +5737,11 @@ int srz_add_e(char* sopt, char* lopt, char* desc, int* dest, int init, srz_enum_
     opt->ident          = ___srz___.opt_idx;
     opt->fin            = 0;
     opt->srt            = sopt;
-    opt->lng            = lopt;
+    opt->lng            = _srz_scoped(lopt);
+    if(lopt && !opt->lng){
+        ___srz___.err_no = SRZ_ERR_NOMEM;
+        return -1;
+    }
     opt->desc           = desc;
     opt->atype          = SRZ_ARG_REQ;
     opt->val.type       = SRZ_VAL_ENUM;
@@ -1109,6 +5750,8 @@ int srz_add_e(char* sopt, char* lopt, char* desc, int* dest, int init, srz_enum_
     opt->val.init.i     = init;
     opt->val.is_vector  = 0;
 
+    *dest = init;
+
     ___srz___.opt_idx++;
     opt = ___srz___.opts + ___srz___.opt_idx;
     opt->fin = 1;
@@ -1121,20 +5764,70 @@ int srz_add_E(char* sopt, char* lopt, char* desc, int** dest, srz_enum_t* map)
     _srz_init();
 
     if(_srz_add_check()){
-        ___srz___.errno = SRZ_ERR_SOPTS_MAX_TOO_SMALL;
+        ___srz___.err_no = SRZ_ERR_SOPTS_MAX_TOO_SMALL;
         return -1 ;
     }
 
     srz_opt_t* opt = ___srz___.opts + ___srz___.opt_idx;
     opt->ident          = ___srz___.opt_idx;
+    opt->fin            = 0;
     opt->srt            = sopt;
-    opt->lng            = lopt;
+    opt->lng            = _srz_scoped(lopt);
+    if(lopt && !opt->lng){
+        ___srz___.err_no = SRZ_ERR_NOMEM;
+        return -1;
+    }
     opt->desc           = desc;
     opt->atype          = SRZ_ARG_REQ;
     opt->val.type       = SRZ_VAL_ENUM;
     opt->val.dest       = dest;
     opt->val.enm_map    = map;
     opt->val.is_vector  = 1;
+    opt->val.delim      = '\0';
+
+    *dest = NULL;
+
+    ___srz___.opt_idx++;
+    opt = ___srz___.opts + ___srz___.opt_idx;
+    opt->fin = 1;
+
+    return 0;
+}
+
+int srz_add_es(char* sopt, char* lopt, char* desc, srz_ens_t* dest, srz_enum_t* map)
+{
+    _srz_init();
+
+    if(_srz_add_check()){
+        ___srz___.err_no = SRZ_ERR_SOPTS_MAX_TOO_SMALL;
+        return -1 ;
+    }
+
+    if(_srz_ens_size(map) > SRZ_ENS_MAX){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_ENS_VALUE));
+        ___srz___.err_no = SRZ_ERR_ENS_VALUE;
+        return -1;
+    }
+
+    srz_opt_t* opt = ___srz___.opts + ___srz___.opt_idx;
+    opt->ident          = ___srz___.opt_idx;
+    opt->fin            = 0;
+    opt->srt            = sopt;
+    opt->lng            = _srz_scoped(lopt);
+    if(lopt && !opt->lng){
+        ___srz___.err_no = SRZ_ERR_NOMEM;
+        return -1;
+    }
+    opt->desc           = desc;
+    opt->atype          = SRZ_ARG_REQ;
+    opt->val.type       = SRZ_VAL_ENUM_SET;
+    opt->val.dest       = dest;
+    opt->val.enm_map    = map;
+    opt->val.is_vector  = 0;
+    opt->val.delim      = '\0';
+
+    dest->bits = NULL;
+    dest->size = 0;
 
     ___srz___.opt_idx++;
     opt = ___srz___.opts + ___srz___.opt_idx;
@@ -1143,13 +5836,114 @@ int srz_add_E(char* sopt, char* lopt, char* desc, int** dest, srz_enum_t* map)
     return 0;
 }
 
-static inline char* _srz_opt_type2str(srz_opt_type_t opt_type)
+int srz_add_n(char* sopt, char* lopt, char* desc, int* dest)
+{
+    if(srz_add_i(sopt, lopt, desc, dest, 0)){
+        return -1;
+    }
+
+    ___srz___.opts[___srz___.opt_idx - 1].atype = SRZ_ARG_NON;
+    return 0;
+}
+
+int srz_add_z(char* sopt, char* lopt, char* desc, uint64_t* dest, uint64_t init, srz_val_type_t type)
+{
+    if(srz_add_u64(sopt, lopt, desc, dest, init)){
+        return -1;
+    }
+
+    ___srz___.opts[___srz___.opt_idx - 1].val.type = type;
+    return 0;
+}
+
+int srz_scope(const char* path)
+{
+    _srz_init();
+
+    if(path && !*path){
+        path = NULL;
+    }
+    for(const char* c = path; c && *c; c++){
+        if(*c == '.' && (c == path || c[1] == '.' || c[1] == '\0')){
+            SRZ_FAIL("%s (`%s`)\n", srz_err2str_en(SRZ_ERR_SCOPE), path);
+            ___srz___.err_no = SRZ_ERR_SCOPE;
+            return -1;
+        }
+    }
+
+    ___srz___.scope = path;
+    return 0;
+}
+
+int srz_delim(char delim)
+{
+    _srz_init();
+
+    srz_opt_t* opt = ___srz___.opt_idx ? ___srz___.opts + ___srz___.opt_idx - 1 : NULL;
+    if(!opt || (!opt->val.is_vector && opt->val.type != SRZ_VAL_ENUM_SET)){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_DELIM_SCALAR));
+        ___srz___.err_no = SRZ_ERR_DELIM_SCALAR;
+        return -1;
+    }
+
+    //'.', signs, digits and letters (exponents, hex, inf and nan) would be read by strtod()
+    const bool real = opt->val.type == SRZ_VAL_FLOAT || opt->val.type == SRZ_VAL_DOUBLE;
+    if(real && (isalnum((unsigned char)delim) || delim == '.' || delim == '+' || delim == '-')){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_DELIM_FLOAT));
+        ___srz___.err_no = SRZ_ERR_DELIM_FLOAT;
+        return -1;
+    }
+
+    opt->val.delim = delim;
+    return 0;
+}
+
+int srz_files(void)
+{
+    _srz_init();
+
+    srz_opt_t* opt = ___srz___.opt_idx ? ___srz___.opts + ___srz___.opt_idx - 1 : NULL;
+    if(!opt || !opt->val.is_vector || opt->val.type == SRZ_VAL_BOOL || opt->val.type == SRZ_VAL_STR || _srz_is_enum_type(opt->val.type)){
+        SRZ_FAIL("%s\n", srz_err2str_en(SRZ_ERR_FILE_TYPE));
+        ___srz___.err_no = SRZ_ERR_FILE_TYPE;
+        return -1;
+    }
+
+    opt->val.files = true;
+    return 0;
+}
+
+int srz_cmd(const char* name, const char* desc, srz_cmd_reg_t reg)
+{
+    _srz_init();
+
+    if(___srz___.cmd_idx >= SRZ_CMDS_MAX){
+        SRZ_FAIL("%s. Current size = %i\n", srz_err2str_en(SRZ_ERR_CMDS_MAX_TOO_SMALL), SRZ_CMDS_MAX);
+        ___srz___.err_no = SRZ_ERR_CMDS_MAX_TOO_SMALL;
+        return -1;
+    }
+
+    srz_cmd_t* cmd = ___srz___.cmds + ___srz___.cmd_idx;
+    cmd->name = name;
+    cmd->desc = desc;
+    cmd->reg  = reg;
+
+    ___srz___.cmd_idx++;
+    ___srz___.cmds[___srz___.cmd_idx].name = NULL;
+    ___srz___.cfg.cmds = ___srz___.cmds;
+
+    return 0;
+}
+
+SRZ_COLD static inline char* _srz_opt_type2str(srz_opt_type_t opt_type)
 {
     switch(opt_type){
         case SRZ_OPT_NONE:
             return "none";
         case SRZ_OPT_SHORT:
             return "short";
+        case SRZ_OPT_LONG:
+            return "long";
         case SRZ_OPT_POS:
             return "positional";
         case SRZ_OPT_ARG_MISSING_NONE:
@@ -1164,8 +5958,12 @@ static inline char* _srz_opt_type2str(srz_opt_type_t opt_type)
             return "unknown - short";
         case SRZ_OPT_UNKOWN_LONG:
             return "unknown - long";
+        case SRZ_OPT_AMBIGUOUS_LONG:
+            return "ambiguous - long";
+        case SRZ_OPT_CMD:
+            return "subcommand";
         default:
-            return NULL;
+            return "invalid";
     }
 }
 
@@ -1184,6 +5982,7 @@ static int _srz_opt_handler(srz_opt_type_t opt_type, const srz_opt_t* const opt,
         case SRZ_OPT_LONG:
         case SRZ_OPT_ARG_MISSING_LONG:
         case SRZ_OPT_UNKOWN_LONG:
+        case SRZ_OPT_AMBIGUOUS_LONG:
             opt_name = opt->lng;
             break;
         case SRZ_OPT_NONE:
@@ -1193,6 +5992,10 @@ static int _srz_opt_handler(srz_opt_type_t opt_type, const srz_opt_t* const opt,
             break;
         case SRZ_OPT_POS:
             opt_name = "";
+            break;
+        case SRZ_OPT_CMD:
+            printf("Subcommand %s\n", optval);
+            return 0;
 
     }
 
@@ -1213,19 +6016,90 @@ static int _srz_opt_handler(srz_opt_type_t opt_type, const srz_opt_t* const opt,
         }
     }
 
-    return 0;
+    const srz_cands_t* cands = srz_candidates();
+    if((opt_type == SRZ_OPT_UNKOWN_SHORT || opt_type == SRZ_OPT_UNKOWN_LONG) && cands->count){
+        printf("Did you mean:");
+        for(size_t i = 0; i < cands->count; i++){
+            printf(" %s", cands->names[i]);
+        }
+        printf("\n");
+    }
+
+    switch(opt_type){
+        case SRZ_OPT_SHORT:
+        case SRZ_OPT_LONG:
+        case SRZ_OPT_POS:
+            //optval is always a word of argv, or part of one, and those are writable
+            return srz_store(opt, (char*)optval);
+        default:
+            return 0;
+    }
+}
+
+
+#if SRZ_SECTION
+//Bounds of the srz_opts section, from the linker. Weak, so a program without any SRZ_DEFINE_*() still links.
+extern const srz_opt_t* const __start_srz_opts[] __attribute__((weak));
+extern const srz_opt_t* const __stop_srz_opts[] __attribute__((weak));
+
+//Append count options to the table, all of them or none
+static inline srz_errno_t _srz_section_append(const srz_opt_t* const* start, size_t count)
+{
+    _srz_init();
+    if(SRZ_OPTS_MAX - ___srz___.opt_idx < count + 1){
+        SRZ_FAIL("%s. Current size = %i\n", srz_err2str_en(SRZ_ERR_OPTS_MAX_TOO_SMALL), SRZ_OPTS_MAX);
+        return SRZ_ERR_OPTS_MAX_TOO_SMALL;
+    }
+
+    //Checked here as srz_add_es() does, rather than when the first value is stored
+    for(size_t i = 0; i < count; i++){
+        if(start[i]->val.type == SRZ_VAL_ENUM_SET && _srz_ens_size(start[i]->val.enm_map) > SRZ_ENS_MAX){
+            SRZ_FAIL("%s (`%s`)\n", srz_err2str_en(SRZ_ERR_ENS_VALUE), start[i]->lng ? start[i]->lng : start[i]->srt);
+            return SRZ_ERR_ENS_VALUE;
+        }
+    }
+
+    for(size_t i = 0; i < count; i++){
+        srz_opt_t* opt = ___srz___.opts + ___srz___.opt_idx;
+        *opt = *start[i];
+        opt->ident = (int)___srz___.opt_idx++;
+    }
+    ___srz___.opts[___srz___.opt_idx].fin = 1;
+    return SRZ_ERR_NONE;
 }
 
+//Append the options defined with SRZ_DEFINE_*() to the table, once
+static inline srz_errno_t _srz_section_add(void)
+{
+    const srz_opt_t* const* start = __start_srz_opts;
+    const srz_opt_t* const* stop  = __stop_srz_opts;
+    if(!start || start == stop || ___srz___.section_done){
+        return SRZ_ERR_NONE;
+    }
+
+    const srz_errno_t err = _srz_section_append(start, (size_t)(stop - start));
+    ___srz___.section_done = !err;
+    return err;
+}
+#endif
 
 int srz_parse(int argc, char** argv)
 {
+#if SRZ_SECTION
+    const srz_errno_t err = _srz_section_add();
+    if(err){
+        ___srz___.err_no = err;
+        return -1;
+    }
+#endif
+
     if(!___srz___.init_complete){
-        ___srz___.errno = SRZ_ERR_NO_OPTS_ADDED;
+        ___srz___.err_no = SRZ_ERR_NO_OPTS_ADDED;
         return -1;
     }
 
-    ___srz___.errno = srz_parse_ex(argc,argv,___srz___.opts,_srz_opt_handler,NULL);
-    if(___srz___.errno != SRZ_ERR_NONE){
+    ___srz___.err_no = srz_parse_cfg(argc,argv,___srz___.opts,&___srz___.cfg,_srz_opt_handler,NULL);
+    if(___srz___.err_no != SRZ_ERR_NONE){
         return -1;
     }
 
@@ -1,79 +1,734 @@
+/*
+ * Shiraz tests
+ * ================
+ * Command lines in, handler calls and stored values out. Each case parses with
+ * a handler that stores every value and records every call as a trace, e.g.
+ * "-f --out=a pos=x ?verbose !level ~2 cmd=build", and compares the trace, the
+ * returned error and the destinations with what it expects. A mismatch is a
+ * failure, and the tests exit non-zero.
+ */
+
+#define _POSIX_C_SOURCE 200809L //setenv(), mkstemp(), pread() and fork(), without the GNU extensions
 #include <stdio.h>
-#include <getopt.h> /* getopt */
-#include <stdlib.h> /* exit   */
-#include <stdio.h>  /* printf */
-
-int main(int argc, char **argv)
-{
-  int c;
-
-    while (1)
-    {
-        int option_index = 0;
-        static struct option long_options[] =
-        {
-            {"add",     required_argument, NULL,  'a'},
-            {"append",  no_argument,       NULL,  'p'},
-            {"delete",  required_argument, NULL,  'd'},
-            {"verbose", no_argument,       NULL,  'v'},
-            {"create",  required_argument, NULL,  'c'},
-            {"file",    optional_argument, NULL,  'f'},
-            {NULL,      0,                 NULL,    0}
-        };
-
-        c = getopt_long(argc, argv, "-:a:pd:vc:f::", long_options, &option_index);
-        if (c == -1)
-          break;
-
-        switch (c)
-        {
-          case 0:
-            printf("long option %s", long_options[option_index].name);
-            if (optarg)
-               printf(" with arg %s", optarg);
-            printf("\n");
-            break;
+#include <stdlib.h>
+#include <sys/wait.h>
 
-          case 1:
-            printf("regular argument '%s'\n", optarg);
-            break;
+#include "shiraz.h"
 
-          case 'a':
-            printf("option a with value '%s'\n", optarg);
-            break;
 
-         case 'p':
-            printf("option p\n");
-            break;
+#define TEST_TOKS  32
+#define TEST_TRACE 1024
 
-          case 'd':
-            printf("option d with value '%s'\n", optarg);
-            break;
+typedef struct test {
+    const char* name;
+    void (*run)(void);
+} test_t;
 
-         case 'v':
-            printf("option v\n");
-            break;
+static char test_trace[TEST_TRACE];
+static size_t test_len;
+static bool test_failed;
 
-          case 'c':
-            printf("option c with value '%s'\n", optarg);
-            break;
+#define TEST_CHECK(cond) test_check((cond), #cond, __LINE__)
 
-          case 'f':
-            printf("option f with value '%s'\n", optarg ? optarg : "NULL");
-            break;
+static void test_check(bool ok, const char* what, int line)
+{
+    if(!ok){
+        printf("    line %d: %s\n", line, what);
+        test_failed = true;
+    }
+}
 
-          case '?':
-            printf("Unknown option %c\n", optopt);
-            break;
+static void test_record(const char* entry)
+{
+    const int len = snprintf(test_trace + test_len, sizeof(test_trace) - test_len, "%s%s", test_len ? " " : "", entry);
+    test_len += len > 0 && (size_t)len < sizeof(test_trace) - test_len ? (size_t)len : 0;
+}
+
+static const char* test_name(const srz_opt_t* opt)
+{
+    return !opt ? "" : opt->lng ? opt->lng : opt->srt ? opt->srt : "";
+}
 
-          case ':':
-            printf("Missing option for %c\n", optopt);
+//Record the call, then store the value as srz_parse() would
+static int test_handler(srz_opt_type_t opt_type, const srz_opt_t* const opt, const char* const optval, void* user)
+{
+    (void)user;
+    const char* val = optval ? optval : "";
+    const char* eq  = optval ? "=" : "";
+    char entry[TEST_TRACE];
+    entry[0] = '\0';
+
+    switch(opt_type){
+        case SRZ_OPT_SHORT:
+            snprintf(entry, sizeof(entry), "-%s%s%s", opt->srt, eq, val);
+            break;
+        case SRZ_OPT_LONG:
+            snprintf(entry, sizeof(entry), "--%s%s%s", opt->lng, eq, val);
             break;
+        case SRZ_OPT_POS:
+            snprintf(entry, sizeof(entry), "%s=%s", test_name(opt), val);
+            break;
+        case SRZ_OPT_UNKOWN_NONE:
+        case SRZ_OPT_UNKOWN_LONG:
+        case SRZ_OPT_UNKOWN_SHORT:
+            snprintf(entry, sizeof(entry), "?%s", test_name(opt));
+            break;
+        case SRZ_OPT_ARG_MISSING_NONE:
+        case SRZ_OPT_ARG_MISSING_LONG:
+        case SRZ_OPT_ARG_MISSING_SHORT:
+            snprintf(entry, sizeof(entry), "!%s", test_name(opt));
+            break;
+        case SRZ_OPT_AMBIGUOUS_LONG:
+            snprintf(entry, sizeof(entry), "~%zu", srz_candidates()->count);
+            break;
+        case SRZ_OPT_CMD:
+            snprintf(entry, sizeof(entry), "cmd=%s", val);
+            break;
+        case SRZ_OPT_NONE:
+            break;
+    }
+    test_record(entry);
+
+    switch(opt_type){
+        case SRZ_OPT_SHORT:
+        case SRZ_OPT_LONG:
+        case SRZ_OPT_POS:
+            return srz_store(opt, (char*)optval);
+        default:
+            return 0;
+    }
+}
+
+//Split line at spaces into argv, after a program name. The words are copied, srz_store() writes to them.
+static int test_argv(const char* line, char** argv, char* buf, size_t size)
+{
+    int argc = 0;
+    argv[argc++] = "test";
+    snprintf(buf, size, "%s", line);
+    for(char* tok = strtok(buf, " "); tok && argc < TEST_TOKS; tok = strtok(NULL, " ")){
+        argv[argc++] = tok;
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+//Parse line against opts, and check the error and the trace
+static void test_parse(srz_opt_t* opts, const srz_cfg_t* cfg, const char* line, srz_errno_t err, const char* trace)
+{
+    static const srz_cfg_t dflt = SRZ_CFG_DEFAULT;
+    static char buf[TEST_TRACE];
+    char* argv[TEST_TOKS + 1];
+    const int argc = test_argv(line, argv, buf, sizeof(buf));
+
+    test_len = 0;
+    test_trace[0] = '\0';
+    const srz_errno_t got = srz_parse_cfg(argc, argv, opts, cfg ? cfg : &dflt, test_handler, NULL);
+    if(got != err || strcmp(test_trace, trace)){
+        printf("    `%s`\n      expected %d \"%s\"\n      got      %d \"%s\"\n", line, err, trace, got, test_trace);
+        test_failed = true;
+    }
+}
+
+
+/*
+ * Cases
+ */
+
+static char* str_o;
+
+static void test_clusters(void)
+{
+    srz_opt_t opts[] = { SRZ_FLG(1, "f", "force", "f"), SRZ_FLG(2, "v", "verbose", "v"), SRZ_REQ(3, "o", "out", "o"), SRZ_FIN };
+    opts[2].val.type = SRZ_VAL_STR;
+    opts[2].val.dest = &str_o;
+
+    test_parse(opts, NULL, "-fv -o a -fvob", SRZ_ERR_NONE, "-f -v -o=a -f -v -o=b");
+    test_parse(opts, NULL, "-vo", SRZ_ERR_NONE, "-v !out");
+    TEST_CHECK(str_o && strcmp(str_o, "b") == 0);
+
+    //An unknown character ends the cluster, with one report for that character
+    test_parse(opts, NULL, "-fxv", SRZ_ERR_NONE, "-f ?");
+    test_parse(opts, NULL, "-verbose", SRZ_ERR_NONE, "-v ?force");
+}
+
+static void test_optional(void)
+{
+    srz_opt_t opts[] = { SRZ_OPT(1, "p", "pad", "p"), SRZ_FLG(2, "f", "force", "f"), SRZ_FIN };
+
+    //An optional argument is only ever attached
+    test_parse(opts, NULL, "-p -pf -fp4 --pad --pad=2 x", SRZ_ERR_POSTIONAL_FOUND, "-p -p=f -f -p=4 --pad --pad=2");
+}
+
+static void test_values(void)
+{
+    static char* str;
+    srz_opt_t opts[] = { SRZ_REQ(1, "o", "out", "o"), SRZ_FLG(2, "f", "force", "f"), SRZ_FIN };
+    opts[0].val.type = SRZ_VAL_STR;
+    opts[0].val.dest = &str;
+
+    test_parse(opts, NULL, "--out=a=b --out= --out c", SRZ_ERR_NONE, "--out=a=b --out= --out=c");
+    TEST_CHECK(str && strcmp(str, "c") == 0);
+
+    //A flag given a value is reported, not set
+    test_parse(opts, NULL, "--force=1 --out", SRZ_ERR_NONE, "?force !out");
+}
+
+static void test_abbrev(void)
+{
+    srz_opt_t opts[] = { SRZ_FLG(1, NULL, "verbose", "v"), SRZ_FLG(2, NULL, "version", "v"), SRZ_REQ(3, NULL, "output", "o"), SRZ_FIN };
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+
+    test_parse(opts, &cfg, "--out x --verb --vers --ver --v", SRZ_ERR_NONE, "--output=x --verbose --version ~2 ~2");
+    cfg.abbrev = false;
+    test_parse(opts, &cfg, "--verb", SRZ_ERR_NONE, "?verbose");
+}
+
+static int cmd_jobs;
+
+static srz_opt_t* test_cmd_reg(const srz_cmd_t* cmd, void* user)
+{
+    (void)cmd;
+    (void)user;
+    static srz_opt_t opts[] = { SRZ_REQ(10, "j", "jobs", "j"), SRZ_FLG(11, "v", "vendor", "v"), SRZ_FIN };
+    opts[0].val.type = SRZ_VAL_INT;
+    opts[0].val.dest = &cmd_jobs;
+    return opts;
+}
+
+static void test_subcommands(void)
+{
+    static const srz_cmd_t cmds[] = { { "build", "b", test_cmd_reg }, { "clean", "c", test_cmd_reg }, SRZ_CMD_FIN };
+    srz_opt_t opts[] = { SRZ_FLG(1, "v", "verbose", "v"), SRZ_FLG(2, "g", "global", "g"), SRZ_FIN };
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    cfg.cmds = cmds;
+
+    //Global options still resolve after the subcommand, which shadows the ones it redefines
+    test_parse(opts, &cfg, "-v build -j 4 -g -v", SRZ_ERR_NONE, "-v cmd=build -j=4 -g -v");
+    TEST_CHECK(cmd_jobs == 4);
+    TEST_CHECK(srz_command() == cmds);
+    test_parse(opts, &cfg, "-g", SRZ_ERR_NONE, "-g");
+    TEST_CHECK(srz_command() == NULL);
+}
+
+static void test_constraints(void)
+{
+    const srz_rule_t rules[] = { SRZ_REQUIRED(1), SRZ_CONFLICTS(2, 3), SRZ_RULE_FIN };
+    srz_opt_t opts[] = { SRZ_REQ(1, "i", "input", "i"), SRZ_FLG(2, "a", "all", "a"), SRZ_FLG(3, "n", "none", "n"), SRZ_FIN };
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    cfg.rules = rules;
+
+    test_parse(opts, &cfg, "-i x -a", SRZ_ERR_NONE, "-i=x -a");
+    TEST_CHECK(srz_violation() == NULL);
+    test_parse(opts, &cfg, "-a", SRZ_ERR_CONSTRAINT, "-a");
+    TEST_CHECK(srz_violation() == rules);
+    test_parse(opts, &cfg, "-i x -a -n", SRZ_ERR_CONSTRAINT, "-i=x -a -n");
+    TEST_CHECK(srz_violation() == rules + 1);
+
+    //Merged sources are checked once, on the calling thread
+    char* argv[] = { "test", "-i", "x", NULL };
+    const srz_source_t srcs[] = { SRZ_SRC_ARGV(3, argv) };
+    TEST_CHECK(srz_parse_sources(srcs, 1, opts, &cfg, test_handler, NULL) == SRZ_ERR_NONE);
+    TEST_CHECK(srz_violation() == NULL);
+}
+
+static void test_units(void)
+{
+    static uint64_t size, dur, count;
+    srz_opt_t opts[] = { SRZ_REQ(1, "s", "size", "s"), SRZ_REQ(2, "d", "duration", "d"), SRZ_REQ(3, "c", "count", "c"), SRZ_FIN };
+    opts[0].val.type = SRZ_VAL_SIZE;
+    opts[0].val.dest = &size;
+    opts[1].val.type = SRZ_VAL_DURATION;
+    opts[1].val.dest = &dur;
+    opts[2].val.type = SRZ_VAL_COUNT;
+    opts[2].val.dest = &count;
+
+    test_parse(opts, NULL, "-s 64MiB -d 1h30m -c 10k", SRZ_ERR_NONE, "-s=64MiB -d=1h30m -c=10k");
+    TEST_CHECK(size == 64ull << 20);
+    TEST_CHECK(dur == 90ull * 60 * 1000000000);
+    TEST_CHECK(count == 10000);
+
+    test_parse(opts, NULL, "-s 1.5GB -d 250ms", SRZ_ERR_NONE, "-s=1.5GB -d=250ms");
+    TEST_CHECK(size == 1500000000ull);
+    TEST_CHECK(dur == 250000000ull);
+
+    test_parse(opts, NULL, "-s 12parsecs", SRZ_ERR_BAD_VALUE, "-s=12parsecs");
+}
+
+static void test_vectors(void)
+{
+    static uint32_t* ports;
+    static double* ratios;
+    static char** names;
+    srz_opt_t opts[] = { SRZ_REQ(1, "p", "ports", "p"), SRZ_REQ(2, "r", "ratios", "r"), SRZ_REQ(3, "n", "names", "n"), SRZ_FIN };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_UINT32, .is_vector = true, .delim = ',', .dest = &ports };
+    opts[1].val = (srz_val_t){ .type = SRZ_VAL_DOUBLE, .is_vector = true, .delim = ':', .dest = &ratios };
+    opts[2].val = (srz_val_t){ .type = SRZ_VAL_STR,    .is_vector = true, .delim = ',', .dest = &names };
+
+    test_parse(opts, NULL, "-p 80,443 -p 8080 -r 0.5:1e3:-2 -n a,bc,", SRZ_ERR_NONE, "-p=80,443 -p=8080 -r=0.5:1e3:-2 -n=a,bc,");
+    TEST_CHECK(srz_len(ports) == 3 && ports[0] == 80 && ports[1] == 443 && ports[2] == 8080);
+    TEST_CHECK(srz_len(ratios) == 3 && ratios[0] == 0.5 && ratios[1] == 1e3 && ratios[2] == -2);
+    TEST_CHECK(srz_len(names) == 3 && strcmp(names[0], "a") == 0 && strcmp(names[1], "bc") == 0 && strcmp(names[2], "") == 0);
+
+    //A bad element leaves the vector as it was
+    test_parse(opts, NULL, "-p 1,x,3", SRZ_ERR_BAD_VALUE, "-p=1,x,3");
+    TEST_CHECK(srz_len(ports) == 3);
 
-          default:
-            printf("?? getopt returned character code 0%o ??\n", c);
-         }
+    srz_vec_free(ports);
+    srz_vec_free(ratios);
+    srz_vec_free(names);
+    ports = NULL;
+    ratios = NULL;
+    names = NULL;
+}
+
+//@path only reads a file for an option that asked for it, a bad file is an error rather than an exit
+static void test_files(void)
+{
+    static uint32_t* vals;
+    srz_opt_t opts[] = { SRZ_REQ(1, "v", "vals", "v"), SRZ_FIN };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_UINT32, .is_vector = true, .dest = &vals };
+
+    char path[] = "@/tmp/shiraz-test-XXXXXX";
+    const int fd = mkstemp(path + 1);
+    const uint32_t raw[] = { 7, 8, 9 };
+    TEST_CHECK(fd >= 0 && write(fd, raw, sizeof(raw)) == sizeof(raw));
+    close(fd);
+
+    char line[64], trace[64];
+    snprintf(line, sizeof(line), "-v %s", path);
+    snprintf(trace, sizeof(trace), "-v=%s", path);
+    test_parse(opts, NULL, line, SRZ_ERR_BAD_VALUE, trace);
+    TEST_CHECK(srz_len(vals) == 0);
+
+    opts[0].val.files = true;
+    test_parse(opts, NULL, line, SRZ_ERR_NONE, trace);
+    TEST_CHECK(srz_len(vals) == 3 && vals[0] == 7 && vals[2] == 9);
+    test_parse(opts, NULL, "-v 10 -v @/nonexistent", SRZ_ERR_FILE, "-v=10 -v=@/nonexistent");
+    TEST_CHECK(srz_len(vals) == 4 && vals[3] == 10);
+
+    //A limited parse never opens the file
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    cfg.limits.tokens = 8;
+    test_parse(opts, &cfg, line, SRZ_ERR_BAD_VALUE, trace);
+    TEST_CHECK(srz_len(vals) == 4);
+
+    srz_vec_free(vals);
+    vals = NULL;
+    unlink(path + 1);
+}
+
+enum { PERM_READ = 0, PERM_WRITE = 1, PERM_EXEC = 70 };
+
+static void test_enum_sets(void)
+{
+    static srz_enum_t perms[] = { { PERM_READ, "read" }, { PERM_WRITE, "write" }, { PERM_EXEC, "exec" }, SRZ_ENUM_FIN };
+    static srz_ens_t set;
+    static int level;
+    static srz_enum_t levels[] = { { 1, "low" }, { 2, "high" }, SRZ_ENUM_FIN };
+    srz_opt_t opts[] = { SRZ_REQ(1, "p", "perms", "p"), SRZ_REQ(2, "l", "level", "l"), SRZ_FIN };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_ENUM_SET, .delim = ',', .dest = &set, .enm_map = perms };
+    opts[1].val = (srz_val_t){ .type = SRZ_VAL_ENUM, .dest = &level, .enm_map = levels };
+
+    test_parse(opts, NULL, "-p read,write -p -write,+exec -l high", SRZ_ERR_NONE, "-p=read,write -p=-write,+exec -l=high");
+    TEST_CHECK(srz_ens_has(&set, PERM_READ) && !srz_ens_has(&set, PERM_WRITE) && srz_ens_has(&set, PERM_EXEC));
+    TEST_CHECK(srz_ens_count(&set) == 2 && level == 2);
+
+    test_parse(opts, NULL, "-p none -p all -p -read", SRZ_ERR_NONE, "-p=none -p=all -p=-read");
+    TEST_CHECK(srz_ens_count(&set) == 2 && !srz_ens_has(&set, PERM_READ));
+
+    //A bad name leaves the set as it was
+    test_parse(opts, NULL, "-p read,wirte", SRZ_ERR_BAD_VALUE, "-p=read,wirte");
+    TEST_CHECK(!srz_ens_has(&set, PERM_READ));
+    srz_ens_free(&set);
+}
+
+#if SRZ_SECTION
+static int def_verbose;
+static char* def_name;
+static srz_ens_t def_perms;
+static srz_enum_t def_perm_map[] = { { PERM_READ, "read" }, { PERM_EXEC, "exec" }, SRZ_ENUM_FIN };
+SRZ_DEFINE_FLG(verbose, "V", "def.verbose", "Print more", &def_verbose);
+SRZ_DEFINE_STR(name, "", "def.name", "A name", &def_name);
+SRZ_DEFINE_ENS(perms, "", "def.perms", "Permissions", &def_perms, def_perm_map);
+
+//Options defined at file scope reach srz_parse() through the srz_opts section
+static void test_section(void)
+{
+    static char buf[TEST_TRACE];
+    char* argv[TEST_TOKS + 1];
+    int argc = test_argv("-V --def.name=x --def.perms=exec", argv, buf, sizeof(buf));
+    TEST_CHECK(srz_parse(argc, argv) == 0);
+    TEST_CHECK(def_verbose && def_name && !strcmp(def_name, "x") && srz_ens_has(&def_perms, PERM_EXEC));
+    const size_t added = ___srz___.opt_idx;
+    TEST_CHECK(added == 3);
+
+    //A second parse must not append them again
+    argc = test_argv("--def.name=y", argv, buf, sizeof(buf));
+    TEST_CHECK(srz_parse(argc, argv) == 0 && ___srz___.opt_idx == added && !strcmp(def_name, "y"));
+
+    srz_ens_free(&def_perms);
+
+    //A map with a value past SRZ_ENS_MAX is refused before anything is appended. The
+    //refusal is an SRZ_FAIL(), which exits with SRZ_HARD_EXIT, so it runs in a child.
+    static srz_enum_t big_map[] = { { SRZ_ENS_MAX, "big" }, SRZ_ENUM_FIN };
+    static srz_ens_t big;
+    const srz_opt_t ok  = { .atype = SRZ_ARG_REQ, .lng = "def.ok", .val = { .type = SRZ_VAL_ENUM_SET, .dest = &def_perms, .enm_map = def_perm_map } };
+    const srz_opt_t bad = { .atype = SRZ_ARG_REQ, .lng = "def.big", .val = { .type = SRZ_VAL_ENUM_SET, .dest = &big, .enm_map = big_map } };
+    const srz_opt_t* const defs[] = { &ok, &bad };
+    fflush(stdout);
+    const pid_t pid = fork();
+    if(pid == 0){
+        exit(_srz_section_append(defs, 2) == SRZ_ERR_ENS_VALUE && ___srz___.opt_idx == added ? 0 : 1);
+    }
+    int status = 0;
+    TEST_CHECK(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status));
+    TEST_CHECK(WEXITSTATUS(status) == (SRZ_HARD_EXIT ? (0xDEAD & 0xFF) : 0));
+    TEST_CHECK(___srz___.opt_idx == added);
+}
+#endif
+
+static void test_last_wins(void)
+{
+    static int level;
+    static int* all;
+    srz_opt_t opts[] = { SRZ_REQ(1, "l", "level", "l"), SRZ_FLG(2, "f", "force", "f"), SRZ_REQ(3, "a", "all", "a"), SRZ_FIN };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_INT, .dest = &level };
+    opts[2].val = (srz_val_t){ .type = SRZ_VAL_INT, .is_vector = true, .dest = &all };
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+    cfg.last_wins = true;
+
+    //Vectors are handed on as they come, scalars once, in the order of their last occurrence
+    test_parse(opts, &cfg, "-l 1 -f -a 1 -l 2 -a 2", SRZ_ERR_NONE, "-a=1 -a=2 -f -l=2");
+    TEST_CHECK(level == 2 && srz_len(all) == 2);
+    srz_vec_free(all);
+    all = NULL;
+}
+
+static void test_sources(void)
+{
+    static int level, port;
+    static char* name;
+    srz_opt_t opts[] = { SRZ_REQ(1, "l", "log-level", "l"), SRZ_REQ(2, "p", "db.port", "p"), SRZ_REQ(3, "n", "name", "n"), SRZ_FIN };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_INT, .dest = &level };
+    opts[1].val = (srz_val_t){ .type = SRZ_VAL_INT, .dest = &port };
+    opts[2].val = (srz_val_t){ .type = SRZ_VAL_STR, .dest = &name };
+
+    char path[] = "/tmp/shiraz-test-XXXXXX";
+    const int fd = mkstemp(path);
+    TEST_CHECK(fd >= 0);
+    const char text[] = "# defaults\nlog-level = 1\nname file\n[db]\nport 5432\n";
+    TEST_CHECK(write(fd, text, sizeof(text) - 1) == (ssize_t)sizeof(text) - 1);
+    close(fd);
+    setenv("SHIRAZ_TEST_LOG_LEVEL", "2", 1);
+    setenv("SHIRAZ_TEST_DB__PORT", "6432", 1);
+
+    //Lowest precedence first, a later source replaces an earlier one's values
+    char* argv[] = { "test", "-l", "3", NULL };
+    const srz_source_t srcs[] = { SRZ_SRC_FILE(path, false), SRZ_SRC_ENV("SHIRAZ_TEST_"), SRZ_SRC_ARGV(3, argv) };
+    test_len = 0;
+    test_trace[0] = '\0';
+    TEST_CHECK(srz_parse_sources(srcs, 3, opts, NULL, test_handler, NULL) == SRZ_ERR_NONE);
+    TEST_CHECK(strcmp(test_trace, "--name=file --db.port=6432 -l=3") == 0);
+    TEST_CHECK(level == 3 && port == 6432 && name && strcmp(name, "file") == 0);
+
+    const srz_source_t missing[] = { SRZ_SRC_FILE("/nonexistent/shiraz.conf", true) };
+    TEST_CHECK(srz_parse_sources(missing, 1, opts, NULL, test_handler, NULL) == SRZ_ERR_NONE);
+
+    //Without a prefix, PATH, HOME and the like are not options and are skipped
+    setenv("LOG_LEVEL", "5", 1);
+    unsetenv("NAME");
+    const srz_source_t env[] = { SRZ_SRC_ENV(NULL) };
+    test_len = 0;
+    test_trace[0] = '\0';
+    TEST_CHECK(srz_parse_sources(env, 1, opts, NULL, test_handler, NULL) == SRZ_ERR_NONE);
+    TEST_CHECK(strcmp(test_trace, "--log-level=5") == 0 && level == 5);
+    unsetenv("LOG_LEVEL");
+
+    //A parse after the texts are freed keeps its own
+    srz_sources_free();
+    name = NULL;
+    test_len = 0;
+    TEST_CHECK(srz_parse_sources(srcs, 3, opts, NULL, test_handler, NULL) == SRZ_ERR_NONE);
+    TEST_CHECK(port == 6432 && name && strcmp(name, "file") == 0);
+    srz_sources_free();
+
+    unlink(path);
+    unsetenv("SHIRAZ_TEST_LOG_LEVEL");
+    unsetenv("SHIRAZ_TEST_DB__PORT");
+}
+
+static void test_limits(void)
+{
+    static int* vals;
+    srz_opt_t opts[] = { SRZ_REQ(1, "v", "vals", "v"), SRZ_FLG(2, "f", "force", "f"), SRZ_FIN };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_INT, .is_vector = true, .delim = ',', .dest = &vals };
+    srz_cfg_t cfg = SRZ_CFG_DEFAULT;
+
+    cfg.limits.tokens = 2;
+    test_parse(opts, &cfg, "-f -f -f", SRZ_ERR_LIMIT_TOKENS, "-f -f");
+    cfg.limits.tokens = 0;
+
+    cfg.limits.bytes = 8;
+    test_parse(opts, &cfg, "-f --force", SRZ_ERR_LIMIT_BYTES, "-f");
+    cfg.limits.bytes = 0;
+
+    cfg.limits.elems = 3;
+    test_parse(opts, &cfg, "-v 1,2,3 -v 4", SRZ_ERR_LIMIT_ELEMS, "-v=1,2,3 -v=4");
+    TEST_CHECK(srz_len(vals) == 3);
+    srz_vec_free(vals);
+    vals = NULL;
+    cfg.limits.elems = 0;
+
+    //Nor may untrusted input ask for completions, which exit
+    cfg.limits.tokens = 8;
+    test_parse(opts, &cfg, SRZ_COMPLETE_ARG " -f", SRZ_ERR_NONE, "? -f");
+}
+
+//srz_feed_bytes() reuses its buffer for every token, the values kept must not point into it
+static void test_stream(void)
+{
+    static char* name;
+    static int level;
+    srz_opt_t opts[] = { SRZ_REQ(1, "n", "name", "n"), SRZ_REQ(2, "l", "level", "l"), SRZ_FIN };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_STR, .dest = &name };
+    opts[1].val = (srz_val_t){ .type = SRZ_VAL_INT, .dest = &level };
+
+    srz_stream_t* stream = NULL;
+    test_len = 0;
+    test_trace[0] = '\0';
+    TEST_CHECK(srz_stream_open(&stream, opts, NULL, test_handler, NULL) == SRZ_ERR_NONE);
+    const char data[] = "--name\0first\0-l\0" "7\0--na";
+    for(size_t i = 0; i < sizeof(data) - 1; i++){
+        TEST_CHECK(srz_feed_bytes(stream, data + i, 1) == SRZ_ERR_NONE);
+    }
+    TEST_CHECK(srz_feed_bytes(stream, "me=xxxxxxxxxxxxxxxx", 19) == SRZ_ERR_NONE);
+    TEST_CHECK(srz_finish(stream) == SRZ_ERR_NONE);
+    TEST_CHECK(strcmp(test_trace, "--name=first -l=7 --name=xxxxxxxxxxxxxxxx") == 0);
+    TEST_CHECK(name && strcmp(name, "xxxxxxxxxxxxxxxx") == 0 && level == 7);
+    srz_sources_free();
+}
+
+//Events come out exactly as the handler calls would have, with values as offsets into argv
+static void test_events(void)
+{
+    srz_opt_t opts[] = { SRZ_FLG(1, "f", "force", "f"), SRZ_REQ(3, "o", "out", "o"), SRZ_POS(4, "", "file", "file"), SRZ_FIN };
+    static char buf[TEST_TRACE];
+    char* argv[TEST_TOKS + 1];
+    const int argc = test_argv("-f --out=a -o b in -x -fo c --out", argv, buf, sizeof(buf));
+    const srz_event_t want[] = {
+        { 1, SRZ_OPT_SHORT,            1, SRZ_EVENT_NOVAL, 0 },
+        { 3, SRZ_OPT_LONG,             2, 6,               1 },
+        { 3, SRZ_OPT_SHORT,            4, 0,               1 },
+        { 4, SRZ_OPT_POS,              5, 0,               2 },
+        { 0, SRZ_OPT_UNKOWN_NONE,      6, SRZ_EVENT_NOVAL, 0 },
+        { 1, SRZ_OPT_SHORT,            7, SRZ_EVENT_NOVAL, 0 },
+        { 3, SRZ_OPT_SHORT,            8, 0,               1 },
+        { 3, SRZ_OPT_ARG_MISSING_LONG, 9, SRZ_EVENT_NOVAL, 0 },
+    };
+    const size_t nwant = sizeof(want) / sizeof(want[0]);
+
+    srz_event_t events[TEST_TOKS];
+    size_t count = 0;
+    TEST_CHECK(srz_parse_events(argc, argv, opts, NULL, events, TEST_TOKS, &count) == SRZ_ERR_NONE);
+    TEST_CHECK(count == nwant);
+    for(size_t i = 0; i < count && i < nwant; i++){
+        const srz_event_t* e = events + i;
+        if(e->ident != want[i].ident || e->type != want[i].type || e->arg != want[i].arg || e->off != want[i].off || e->len != want[i].len){
+            printf("    event %zu: expected %d %d %u %u %u, got %d %d %u %u %u\n", i, want[i].ident, want[i].type, want[i].arg, want[i].off, want[i].len,
+                   e->ident, e->type, e->arg, e->off, e->len);
+            test_failed = true;
+        }
+    }
+    TEST_CHECK(strcmp(argv[events[1].arg] + events[1].off, "a") == 0 && strcmp(argv[events[6].arg] + events[6].off, "c") == 0);
+
+    //Too few events: the first max are written, and count says how many it takes
+    srz_event_t few[3];
+    count = 0;
+    TEST_CHECK(srz_parse_events(argc, argv, opts, NULL, few, 3, &count) == SRZ_ERR_EVENTS_MAX_TOO_SMALL);
+    TEST_CHECK(count == nwant && memcmp(few, events, sizeof(few)) == 0);
+}
+
+//Published values attach as they were, a file that lies about them is refused, and detaching unbinds them
+static void test_shared(void)
+{
+    static int num;
+    static char* str;
+    static char** strs;
+    srz_opt_t opts[] = { SRZ_REQ(1, "n", "num", "n"), SRZ_REQ(2, "s", "str", "s"), SRZ_REQ(3, "S", "strs", "S"), SRZ_FIN };
+    opts[0].val = (srz_val_t){ .type = SRZ_VAL_INT, .dest = &num };
+    opts[1].val = (srz_val_t){ .type = SRZ_VAL_STR, .dest = &str };
+    opts[2].val = (srz_val_t){ .type = SRZ_VAL_STR, .is_vector = true, .delim = ',', .dest = &strs };
+
+    test_parse(opts, NULL, "-n 7 -s one -S a,b", SRZ_ERR_NONE, "-n=7 -s=one -S=a,b");
+    int fd = -1;
+    TEST_CHECK(srz_publish(opts, &fd) == SRZ_ERR_NONE);
+    srz_vec_free(strs);
+    num = 0;
+    str = NULL;
+    strs = NULL;
+
+    TEST_CHECK(srz_attach(opts, fd) == SRZ_ERR_NONE);
+    TEST_CHECK(num == 7 && str && strcmp(str, "one") == 0);
+    TEST_CHECK(srz_len(strs) == 2 && strcmp(strs[0], "a") == 0 && strcmp(strs[1], "b") == 0);
+    TEST_CHECK(srz_detach(opts) == SRZ_ERR_NONE);
+    TEST_CHECK(num == 7 && !str && !strs);
+    TEST_CHECK(srz_detach(opts) == SRZ_ERR_SHARED);
+
+    //Point the first string of the vector past the end of the file
+    uint64_t off = 0;
+    const uint64_t bad = UINT64_C(1) << 40;
+    const size_t ent = sizeof(srz_shared_hdr_t) + 2 * sizeof(srz_shared_ent_t); //The vector's entry starts with its offset
+    TEST_CHECK(pread(fd, &off, sizeof(off), ent) == sizeof(off) && off);
+    TEST_CHECK(pwrite(fd, &bad, sizeof(bad), off) == sizeof(bad));
+    TEST_CHECK(srz_attach(opts, fd) == SRZ_ERR_SHARED_LAYOUT);
+    TEST_CHECK(!str && !strs);
+    close(fd);
+}
+
+//Every decimal the fast path takes must come out with the bits strtod() gives it
+static void test_strtod(void)
+{
+    uint64_t x = UINT64_C(0x9E3779B97F4A7C15);
+    size_t taken = 0;
+    for(int n = 0; n < 1000000; n++){
+        char buf[64];
+        size_t len = 0;
+        #define TEST_RAND(m) (x ^= x << 13, x ^= x >> 7, x ^= x << 17, (size_t)(x % (m)))
+        if(TEST_RAND(4) == 0){ buf[len++] = TEST_RAND(2) ? '-' : '+'; }
+        for(size_t i = TEST_RAND(21); i > 0; i--){ buf[len++] = (char)('0' + TEST_RAND(10)); }
+        if(TEST_RAND(2)){
+            buf[len++] = '.';
+            for(size_t i = TEST_RAND(21); i > 0; i--){ buf[len++] = (char)('0' + TEST_RAND(10)); }
+        }
+        if(TEST_RAND(3) == 0){
+            buf[len++] = TEST_RAND(2) ? 'e' : 'E';
+            if(TEST_RAND(2)){ buf[len++] = TEST_RAND(2) ? '-' : '+'; }
+            for(size_t i = TEST_RAND(4); i > 0; i--){ buf[len++] = (char)('0' + TEST_RAND(10)); }
+        }
+        #undef TEST_RAND
+        buf[len] = '\0';
+
+        double fast = 0;
+        if(!_srz_parse_double_fast(_srz_slice(buf, len), &fast)){
+            continue;
+        }
+        taken++;
+        char* end = NULL;
+        const double slow = strtod(buf, &end);
+        if(end != buf + len || memcmp(&fast, &slow, sizeof(double))){
+            printf("    `%s`: %.17g, strtod() %.17g\n", buf, fast, slow);
+            test_failed = true;
+            return;
+        }
     }
-    return 0;
+    TEST_CHECK(taken > 100000);
 }
 
+//Render the help into a pipe, and check the error and the text written
+static void test_help_text(const srz_opt_t* opts, const char* prog, const char* section, srz_errno_t err, const char* text)
+{
+    static char buf[TEST_TRACE];
+    int fds[2];
+    if(pipe(fds)){
+        TEST_CHECK(!"pipe()");
+        return;
+    }
+
+    const srz_errno_t got = srz_help(opts, prog, section, fds[1]);
+    close(fds[1]);
+    size_t len = 0;
+    for(ssize_t n = 1; n > 0 && len < sizeof(buf) - 1; len += n > 0 ? (size_t)n : 0){
+        n = read(fds[0], buf + len, sizeof(buf) - 1 - len);
+    }
+    buf[len] = '\0';
+    close(fds[0]);
+
+    if(got != err || strcmp(buf, text)){
+        printf("    help %s %s\n      expected %d\n%s      got      %d\n%s", prog ? prog : "NULL", section ? section : "NULL", err, text, got, buf);
+        test_failed = true;
+    }
+}
+
+static void test_help(void)
+{
+    srz_opt_t opts[] = {
+        SRZ_FLG(1, "v", "verbose", "Print every step"),
+        SRZ_REQ(2, "p", "net.port", "Port to listen on. Ports below 1024 need the capability to bind them, or the parse succeeds and the listen fails"),
+        SRZ_OPT(3, "", "net.host", "Host name"),
+        SRZ_POS(4, "", "file", "Input file"),
+        SRZ_FIN
+    };
+
+    test_help_text(opts, "prog", NULL, SRZ_ERR_NONE,
+        "Usage: prog [options] <file>\n"
+        "\n"
+        "Options:\n"
+        "  -v, --verbose         Print every step\n"
+        "  -p, --net.port=<arg>  Port to listen on. Ports below 1024 need the capability\n"
+        "                        to bind them, or the parse succeeds and the listen fails\n"
+        "  --net.host[=<arg>]    Host name\n"
+        "  <file>                Input file\n");
+    test_help_text(opts, "prog", "net", SRZ_ERR_NONE,
+        "Usage: prog [options] <file>\n"
+        "\n"
+        "Options under net:\n"
+        "  -p, --net.port=<arg>  Port to listen on. Ports below 1024 need the capability\n"
+        "                        to bind them, or the parse succeeds and the listen fails\n"
+        "  --net.host[=<arg>]    Host name\n");
+    //An empty argv has no program name to show
+    test_help_text(opts, NULL, "net", SRZ_ERR_NONE,
+        "Usage: [options] <file>\n"
+        "\n"
+        "Options under net:\n"
+        "  -p, --net.port=<arg>  Port to listen on. Ports below 1024 need the capability\n"
+        "                        to bind them, or the parse succeeds and the listen fails\n"
+        "  --net.host[=<arg>]    Host name\n");
+    //A section is a whole scope, not a prefix of one, and an empty one writes nothing
+    test_help_text(opts, "prog", "ne", SRZ_ERR_HELP_SECTION, "");
+    test_help_text(opts, "prog", "db", SRZ_ERR_HELP_SECTION, "");
+}
+
+static test_t tests[] = {
+    { "clusters",    test_clusters    },
+    { "optional",    test_optional    },
+    { "values",      test_values      },
+    { "abbrev",      test_abbrev      },
+    { "subcommands", test_subcommands },
+    { "constraints", test_constraints },
+    { "units",       test_units       },
+    { "vectors",     test_vectors     },
+    { "files",       test_files       },
+    { "enum-sets",   test_enum_sets   },
+#if SRZ_SECTION
+    { "section",     test_section     },
+#endif
+    { "last-wins",   test_last_wins   },
+    { "sources",     test_sources     },
+    { "limits",      test_limits      },
+    { "stream",      test_stream      },
+    { "events",      test_events      },
+    { "shared",      test_shared      },
+    { "strtod",      test_strtod      },
+    { "help",        test_help        },
+    { NULL, NULL },
+};
+
+
+int main(int argc, char** argv)
+{
+    const char* only = argc > 1 ? argv[1] : NULL;
+    int failed = 0;
+
+    for(test_t* t = tests; t->name; t++){
+        if(only && strcmp(only, t->name)){
+            continue;
+        }
+
+        test_failed = false;
+        t->run();
+        printf("%-16s %s\n", t->name, test_failed ? "FAILED" : "ok");
+        failed |= test_failed;
+    }
+
+    return failed;
+}